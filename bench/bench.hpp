@@ -0,0 +1,43 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <chrono>
+#include <string>
+
+/* Keeps the optimizer from dropping a result the benchmark does not otherwise use */
+template <typename T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Runs fn until at least minSeconds have passed and prints the mean time per
+ * call. Returns nanoseconds per call so callers can print ratios. */
+template <typename Fn>
+double measure(const std::string &name, Fn &&fn, double minSeconds = 0.5)
+{
+    using clock = std::chrono::steady_clock;
+
+    /* warm caches and lazily built tables */
+    fn();
+
+    size_t iterations = 0;
+    size_t batch = 1;
+    auto start = clock::now();
+    double elapsed = 0.0;
+    while (elapsed < minSeconds)
+    {
+        for (size_t i = 0; i < batch; ++i)
+        {
+            fn();
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    double nanos = elapsed * 1e9 / iterations;
+    fmt::print(" * {:<40} {:>12.0f} ns/op  ({} runs)\n", name, nanos, iterations);
+    return nanos;
+}
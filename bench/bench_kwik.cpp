@@ -0,0 +1,67 @@
+/**
+ * Kwik packed script decoding: the decoder as it was (a string per token,
+ * find/replace per alphabet symbol, substr, pow and stoi per token) against
+ * decodePackedScript(). Payloads are encoded the way kwik packs its download
+ * page, at the sizes kwik serves. */
+#include "bench.hpp"
+#include "reference_kwik.hpp"
+#include <parsers.hpp>
+#include <vector>
+
+using namespace AnimepaheCLI;
+
+/* the script behind a kwik download page: player setup and the download form */
+static std::string kwikPlaintext(size_t size)
+{
+    std::string text;
+    for (int i = 0; text.size() < size; ++i)
+    {
+        text += fmt::format("var _0x{:04x}=['\\x64\\x61\\x74\\x61','{:032x}'];document.querySelector('#p{}').setAttribute('data-n','{}');", i, i * 2654435761u, i, i * 7);
+    }
+    text += R"(<form action="https://kwik.si/d/AbCdEf123456" method="POST"><input type="hidden" name="_token" value="q8Yh2nQp0LmWb3XcR7tZ1vKjE5sGdA9uFoIy4TeN"><button type="submit" class="button is-uppercase is-success">Download</button></form>)";
+    return text;
+}
+
+int main()
+{
+    struct Config
+    {
+        const char *name;
+        size_t size;
+        std::string alphabet;
+        int offset;
+        int base;
+    };
+    const std::vector<Config> configs = {
+        {"4 KiB, base 5", 4 * 1024, "hIfKsNVqZ", 28, 5},
+        {"16 KiB, base 6", 16 * 1024, "RuWzDoGjc", 41, 6},
+        {"64 KiB, base 8", 64 * 1024, "kYxPbaLmTe", 17, 8},
+    };
+
+    fmt::print("\n Kwik packed script decoding\n");
+    for (const Config &config : configs)
+    {
+        const std::string plain = kwikPlaintext(config.size);
+        const std::string encoded = ReferenceKwik::encode(plain, config.alphabet, config.offset, config.base);
+
+        const std::string expected = ReferenceKwik::decodeJSStyle(encoded, config.alphabet, config.offset, config.base);
+        if (expected != plain || decodePackedScript(encoded, config.alphabet, config.offset, config.base) != expected)
+        {
+            fmt::print(" * {}: outputs differ, benchmark is not comparing like with like\n", config.name);
+            return 1;
+        }
+
+        fmt::print("\n {} ({} encoded bytes)\n", config.name, encoded.size());
+        double before = measure("string tokens", [&]()
+        {
+            keep(ReferenceKwik::decodeJSStyle(encoded, config.alphabet, config.offset, config.base));
+        });
+        double after = measure("lookup tables", [&]()
+        {
+            keep(decodePackedScript(encoded, config.alphabet, config.offset, config.base));
+        });
+        fmt::print(" * speedup: {:.2f}x\n", before / after);
+    }
+    fmt::print("\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * Play page parse cost: the regex loop into string maps with patterns compiled
+ * per call (as before the Patterns registry) and precompiled, against
+ * PlayPageScanner on the whole page and fed in network-sized chunks, where it
+ * stops early. */
+#include "bench.hpp"
+#include "reference_entities.hpp"
+#include <parsers.hpp>
+#include <re2/re2.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace AnimepaheCLI;
+
+/* A play page shaped like the real one: page chrome around a download menu of six sources */
+static std::string samplePlayPage()
+{
+    std::string html = "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<title>Sample Series Ep. 7 :: animepahe</title>\n";
+    for (int i = 0; i < 40; ++i)
+    {
+        html += fmt::format("<link rel=\"preload\" href=\"/static/chunk-{}.js\" as=\"script\">\n", i);
+    }
+    html += "</head>\n<body>\n<div class=\"theatre\">\n";
+    for (int i = 0; i < 200; ++i)
+    {
+        html += fmt::format("<div class=\"col-{}\"><a href=\"/play/abc/{:064x}\" title=\"Episode {}\">Episode {}</a></div>\n", i % 12, i, i, i);
+    }
+    html += "<div id=\"pickDownload\" class=\"dropdown-menu\">\n";
+    const char *fansubs[] = {"SubsPlease", "Erai-raws", "Judas"};
+    const char *resolutions[] = {"360p", "720p", "1080p"};
+    for (int i = 0; i < 6; ++i)
+    {
+        std::string badge = i >= 3 ? "<span class=\"badge badge-warning\">eng</span>" : "<span class=\"badge badge-primary\">BD</span>";
+        html += fmt::format("<a href=\"https://pahe.win/{:06X}\" target=\"_blank\" class=\"dropdown-item\">\n  {} &middot; {} ({}MB) {}</a>\n",
+                            0xA1B2C3 + i, fansubs[i % 3], resolutions[i % 3], 120 * (i + 1), badge);
+    }
+    html += "</div>\n";
+    for (int i = 0; i < 60; ++i)
+    {
+        html += fmt::format("<script>window.__data_{} = {{\"k\": \"{:032x}\"}};</script>\n", i, i * 7919);
+    }
+    html += "</div>\n</body>\n</html>\n";
+    return html;
+}
+
+/* the parser as it was, every pattern a literal */
+static std::vector<std::map<std::string, std::string>> parsePlayPageLiteral(std::string html)
+{
+    std::vector<std::map<std::string, std::string>> episodeData;
+    RE2::GlobalReplace(&html, R"((\r\n|\r|\n))", "");
+    re2::StringPiece EP_CONSUME = html;
+    std::string dPaheLink;
+    std::string epBlock;
+
+    while (RE2::FindAndConsume(&EP_CONSUME, R"re(<a href="(https://pahe\.win/\S*)"[^>]*>(.*?)</a>)re", &dPaheLink, &epBlock))
+    {
+        std::map<std::string, std::string> content;
+        content["dPaheLink"] = ReferenceEntities::unescape_html_entities(dPaheLink);
+        re2::StringPiece epPiece(epBlock);
+        std::string sourceText;
+        RE2::PartialMatch(epPiece, R"re(\s*([^<]*))re", &sourceText);
+        sourceText.erase(sourceText.find_last_not_of(" \t\n\r") + 1);
+        content["sourceText"] = ReferenceEntities::unescape_html_entities(sourceText);
+
+        epPiece = re2::StringPiece(epBlock);
+        std::string epRes;
+        content["epRes"] = RE2::FindAndConsume(&epPiece, R"re(\b(\d{3,4})p\b)re", &epRes) ? ReferenceEntities::unescape_html_entities(epRes) : "0";
+        content["epLang"] = "jp";
+
+        epPiece = re2::StringPiece(epBlock);
+        std::string spanContent;
+        while (RE2::FindAndConsume(&epPiece, R"re(<span[^>]*>([^<]*)</span>)re", &spanContent))
+        {
+            std::transform(spanContent.begin(), spanContent.end(), spanContent.begin(), ::tolower);
+            if (spanContent == "bd")
+            {
+                continue;
+            }
+            content["epLang"] = spanContent == "dub" ? "eng" : spanContent == "chi" ? "zh" : spanContent;
+            break;
+        }
+        episodeData.push_back(content);
+    }
+    return episodeData;
+}
+
+/* the same loop with its patterns compiled once */
+static std::vector<std::map<std::string, std::string>> parsePlayPageRegex(std::string html)
+{
+    static const RE2 newline(R"((\r\n|\r|\n))");
+    static const RE2 anchor(R"re(<a href="(https://pahe\.win/\S*)"[^>]*>(.*?)</a>)re");
+    static const RE2 text(R"re(\s*([^<]*))re");
+    static const RE2 resolution(R"re(\b(\d{3,4})p\b)re");
+    static const RE2 span(R"re(<span[^>]*>([^<]*)</span>)re");
+    std::vector<std::map<std::string, std::string>> episodeData;
+    RE2::GlobalReplace(&html, newline, "");
+    re2::StringPiece EP_CONSUME = html;
+    std::string dPaheLink;
+    std::string epBlock;
+
+    while (RE2::FindAndConsume(&EP_CONSUME, anchor, &dPaheLink, &epBlock))
+    {
+        std::map<std::string, std::string> content;
+        content["dPaheLink"] = ReferenceEntities::unescape_html_entities(dPaheLink);
+        re2::StringPiece epPiece(epBlock);
+        std::string sourceText;
+        RE2::PartialMatch(epPiece, text, &sourceText);
+        sourceText.erase(sourceText.find_last_not_of(" \t\n\r") + 1);
+        content["sourceText"] = ReferenceEntities::unescape_html_entities(sourceText);
+
+        epPiece = re2::StringPiece(epBlock);
+        std::string epRes;
+        content["epRes"] = RE2::FindAndConsume(&epPiece, resolution, &epRes) ? ReferenceEntities::unescape_html_entities(epRes) : "0";
+        content["epLang"] = "jp";
+
+        epPiece = re2::StringPiece(epBlock);
+        std::string spanContent;
+        while (RE2::FindAndConsume(&epPiece, span, &spanContent))
+        {
+            std::transform(spanContent.begin(), spanContent.end(), spanContent.begin(), ::tolower);
+            if (spanContent == "bd")
+            {
+                continue;
+            }
+            content["epLang"] = spanContent == "dub" ? "eng" : spanContent == "chi" ? "zh" : spanContent;
+            break;
+        }
+        episodeData.push_back(content);
+    }
+    return episodeData;
+}
+
+/* the maps carry no Blu-ray flag, everything else has to agree */
+static bool sameSources(const std::vector<std::map<std::string, std::string>> &maps, const std::vector<EpisodeSource> &sources)
+{
+    if (maps.size() != sources.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < maps.size(); ++i)
+    {
+        const std::string &lang = maps[i].at("epLang");
+        AudioLang expected = lang == "jp" ? AudioLang::Japanese : lang == "eng" ? AudioLang::English : lang == "zh" ? AudioLang::Chinese : AudioLang::Other;
+        if (maps[i].at("dPaheLink") != sources[i].link || std::stoi(maps[i].at("epRes")) != sources[i].resolution || expected != sources[i].lang)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* the page as it arrives from curl, which hands over up to 16 KiB per write callback */
+static std::vector<EpisodeSource> scanChunked(const std::string &page, size_t *consumed)
+{
+    const size_t CHUNK = 16 * 1024;
+    PlayPageScanner scanner;
+    size_t offset = 0;
+    while (offset < page.size())
+    {
+        std::string chunk = page.substr(offset, CHUNK);
+        offset += chunk.size();
+        if (!scanner.feed(chunk))
+        {
+            break;
+        }
+    }
+    *consumed = offset;
+    return scanner.sources();
+}
+
+/* pages fetch_episode must not cache: no menu yet, a menu without anchors, a transfer cut inside the menu */
+static int checkIncomplete(const std::string &page)
+{
+    const size_t menu = page.find("<div id=\"pickDownload\"");
+    const size_t firstAnchor = page.find("<a href=\"https://pahe.win/");
+    const size_t menuEnd = page.find("</div>", firstAnchor);
+    std::string withoutMenu = page;
+    withoutMenu.erase(menu, menuEnd + 6 - menu);
+    std::string emptyMenu = page.substr(0, firstAnchor) + page.substr(menuEnd);
+
+    struct Case
+    {
+        const char *name;
+        std::string html;
+        bool complete;
+    };
+    const Case cases[] = {
+        {"whole page", page, true},
+        {"page without the download menu", withoutMenu, false},
+        {"download menu without links", emptyMenu, false},
+        {"transfer cut inside the menu", page.substr(0, page.find("</a>", firstAnchor) + 4), false},
+        {"challenge page", "<!DOCTYPE html><html><head><title>Just a moment...</title></head><body><div>Checking your browser</div></body></html>", false},
+    };
+
+    int failures = 0;
+    for (const Case &c : cases)
+    {
+        PlayPageScanner scanner;
+        scanner.feed(c.html);
+        bool ok = scanner.complete() == c.complete;
+        fmt::print(" * {:<50} {}\n", fmt::format("{}, {}", c.name, c.complete ? "cached" : "not cached"), ok ? "OK!" : "FAIL!");
+        failures += ok ? 0 : 1;
+    }
+    return failures;
+}
+
+int main()
+{
+    const std::string page = samplePlayPage();
+    fmt::print("\n Caching of scanned menus\n");
+    if (checkIncomplete(page))
+    {
+        return 1;
+    }
+
+    const auto expected = parsePlayPageLiteral(page);
+    size_t consumed = 0;
+    fmt::print("\n Play page parse, {} bytes, {} sources\n\n", page.size(), expected.size());
+
+    if (parsePlayPageRegex(page) != expected || !sameSources(expected, parsePlayPage(page)) || !sameSources(expected, scanChunked(page, &consumed)))
+    {
+        fmt::print(" * results differ, benchmark is not comparing like with like\n");
+        return 1;
+    }
+
+    double literal = measure("regex, compiled per call", [&]()
+    {
+        keep(parsePlayPageLiteral(page));
+    });
+    double precompiled = measure("regex, precompiled", [&]()
+    {
+        keep(parsePlayPageRegex(page));
+    });
+    double scanner = measure("scanner, whole page", [&]()
+    {
+        keep(parsePlayPage(page));
+    });
+    double chunked = measure("scanner, 16 KiB chunks", [&]()
+    {
+        keep(scanChunked(page, &consumed));
+    });
+    fmt::print("\n * scanner vs precompiled regex: {:.2f}x", precompiled / scanner);
+    fmt::print("\n * scanner vs per-call regex: {:.2f}x", literal / scanner);
+    fmt::print("\n * streamed: {} of {} bytes received before the scan stopped, {:.2f}x faster than the whole page\n\n",
+               consumed, page.size(), scanner / chunked);
+    return 0;
+}
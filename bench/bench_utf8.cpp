@@ -0,0 +1,100 @@
+/**
+ * sanitize_utf8 on pages the size of the kwik and pahe.win pages it runs
+ * over: the byte-at-a-time loop it replaced against the vectorized scan,
+ * on clean ASCII, on text with Japanese titles and on text with stray bytes.
+ * Checks first that both agree on random input, exits non-zero if not. */
+#include "bench.hpp"
+#include "reference_utf8.hpp"
+#include <utils.hpp>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace AnimepaheCLI;
+
+/* short random strings biased toward sequence boundaries, every block size and tail length is hit */
+static int checkRandom(int iterations, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    const unsigned char bytes[] = {'a', '<', ' ', 0x7F, 0x80, 0xBF, 0xC2, 0xDF, 0xE3, 0xEF, 0xF0, 0xF4, 0xF7, 0xF8, 0xFF};
+    int mismatches = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        std::string input;
+        for (size_t n = rng() % 100; input.size() < n;)
+        {
+            input += rng() % 3 ? static_cast<char>(bytes[rng() % sizeof(bytes)]) : 'x';
+        }
+        if (sanitize_utf8(input) != ReferenceUtf8::sanitize_utf8(input) && ++mismatches <= 5)
+        {
+            fmt::print(" * mismatch on {} bytes\n", input.size());
+        }
+    }
+    fmt::print(" * {:<40} {}\n", fmt::format("random, {} inputs, seed {}", iterations, seed), mismatches ? fmt::format("{} FAILED!", mismatches) : "OK!");
+    return mismatches;
+}
+
+/* a page of markup around an eval'd script, as kwik serves it */
+static std::string samplePage(size_t size, const std::string &extra, size_t every)
+{
+    std::string page = "<!DOCTYPE html><html><head><title>Sample.Series.-.07.[1080p].mp4 - Kwik</title></head><body>\n";
+    for (size_t line = 0; page.size() < size; ++line)
+    {
+        page += fmt::format("<div class=\"row-{}\"><a href=\"https://kwik.si/f/{:012x}\">Sample Series - {:02}</a></div>\n", line % 7, line * 2654435761u, line % 24);
+        if (every && line % every == 0)
+        {
+            page += extra;
+        }
+    }
+    page.resize(size);
+    return page;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned seed = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : std::random_device{}();
+    fmt::print("\n Agreement with the byte loop\n");
+    if (checkRandom(200000, seed))
+    {
+        return 1;
+    }
+
+    struct Input
+    {
+        std::string name;
+        std::string text;
+    };
+    std::vector<Input> inputs;
+    for (size_t size : {16 * 1024, 64 * 1024, 256 * 1024})
+    {
+        inputs.push_back({fmt::format("{} KiB, ASCII", size / 1024), samplePage(size, "", 0)});
+        inputs.push_back({fmt::format("{} KiB, Japanese titles", size / 1024), samplePage(size, "<h1>\xE8\x91\xAC\xE9\x80\x81\xE3\x81\xAE\xE3\x83\x95\xE3\x83\xAA\xE3\x83\xBC\xE3\x83\xAC\xE3\x83\xB3</h1>\n", 4)});
+        inputs.push_back({fmt::format("{} KiB, stray bytes", size / 1024), samplePage(size, "<p>\xA0\xFF\xC3</p>\n", 40)});
+    }
+
+    for (const Input &input : inputs)
+    {
+        if (sanitize_utf8(input.text) != ReferenceUtf8::sanitize_utf8(input.text))
+        {
+            fmt::print(" * {}: outputs differ, FAILED!\n", input.name);
+            return 1;
+        }
+
+        const double megabytes = input.text.size() / (1024.0 * 1024.0);
+        fmt::print("\n {}\n", input.name);
+        double reference = measure("byte loop", [&]()
+        {
+            keep(ReferenceUtf8::sanitize_utf8(input.text));
+        });
+        /* the caller hands over a page it owns; the copy here only restores the input */
+        double current = measure("sanitize_utf8 (with copy)", [&]()
+        {
+            std::string text = input.text;
+            keep(sanitize_utf8(std::move(text)));
+        });
+        fmt::print(" * byte loop {:>10.0f} MB/s, sanitize_utf8 {:>10.0f} MB/s, {:.1f}x\n",
+                   megabytes / (reference / 1e9), megabytes / (current / 1e9), reference / current);
+    }
+    fmt::print("\n");
+    return 0;
+}
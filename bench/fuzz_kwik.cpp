@@ -0,0 +1,270 @@
+/**
+ * Checks for the kwik decoding path, built with the benchmarks:
+ *  - link and _token extraction on the pages in fixtures/
+ *  - decodePackedScript against the reference decoder on random alphabets,
+ *    bases, offsets and payloads, and round trips of encoded text
+ *  - decode throughput of both in MB/s of encoded input
+ * Exits non-zero on the first kind of failure so it can gate a change.
+ *
+ * With ANIMEPAHE_LIBFUZZER defined (clang -fsanitize=fuzzer) the differential
+ * check is a libFuzzer target instead and main() is left out. */
+#include "bench.hpp"
+#include "reference_kwik.hpp"
+#include <parsers.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace AnimepaheCLI;
+
+/**
+ * The reference loops forever when an index written for a symbol contains
+ * the symbol again (a digit symbol), and overflows int once a token's value,
+ * or a power of the base it reads a digit at, passes INT_MAX; neither says
+ * anything about the decoder under test. Tokens are bounded on that value,
+ * worked out the way the reference does, so multi-digit tokens still count. */
+static bool referenceDefined(const std::string &encoded, const std::string &alphabet, int base)
+{
+    for (size_t j = 0; j < alphabet.size(); ++j)
+    {
+        if (std::to_string(j).find(alphabet[j]) != std::string::npos)
+        {
+            return false;
+        }
+    }
+
+    /* each byte is rewritten on its own, symbol after symbol in alphabet order */
+    std::vector<std::string> expansion(256);
+    for (int c = 0; c < 256; ++c)
+    {
+        expansion[c] = std::string(1, static_cast<char>(c));
+        for (size_t j = 0; j < alphabet.size(); ++j)
+        {
+            std::string replaced;
+            for (char e : expansion[c])
+            {
+                replaced += e == alphabet[j] ? std::to_string(j) : std::string(1, e);
+            }
+            expansion[c] = std::move(replaced);
+        }
+    }
+    const std::string digits = ReferenceKwik::baseAlphabet.substr(0, base);
+
+    const char delimiter = alphabet[base];
+    for (size_t begin = 0; begin < encoded.size();)
+    {
+        size_t end = encoded.find(delimiter, begin);
+        end = end == std::string::npos ? encoded.size() : end;
+        std::string token;
+        for (size_t i = begin; i < end; ++i)
+        {
+            token += expansion[static_cast<unsigned char>(encoded[i])];
+        }
+
+        /* the reference's value, read from the last digit up */
+        int64_t value = 0;
+        int64_t power = 1;
+        for (size_t idx = 0; idx < token.size(); ++idx)
+        {
+            size_t digit = digits.find(token[token.size() - 1 - idx]);
+            if (digit != std::string::npos)
+            {
+                if (power > INT32_MAX || (value += static_cast<int64_t>(digit) * power) > INT32_MAX)
+                {
+                    return false;
+                }
+            }
+            power = power > INT32_MAX ? power : power * base;
+        }
+        begin = end + 1;
+    }
+    return true;
+}
+
+/* decode with both, false when they disagree */
+static bool sameDecode(const std::string &encoded, const std::string &alphabet, int offset, int base)
+{
+    return ReferenceKwik::decodeJSStyle(encoded, alphabet, offset, base) == decodePackedScript(encoded, alphabet, offset, base);
+}
+
+#ifdef ANIMEPAHE_LIBFUZZER
+
+/* input: alphabet length, base, offset, alphabet, then the payload */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 3)
+    {
+        return 0;
+    }
+    const size_t length = 1 + data[0] % 16;
+    const int base = data[1] % length;
+    const int offset = data[2] % 128;
+    if (size < 3 + length)
+    {
+        return 0;
+    }
+    const std::string alphabet(reinterpret_cast<const char *>(data + 3), length);
+    const std::string encoded(reinterpret_cast<const char *>(data + 3 + length), size - 3 - length);
+    if (referenceDefined(encoded, alphabet, base) && !sameDecode(encoded, alphabet, offset, base))
+    {
+        __builtin_trap();
+    }
+    return 0;
+}
+
+#else
+
+static std::string readFixture(const std::string &name)
+{
+    std::ifstream infile(std::string(ANIMEPAHE_FIXTURE_DIR) + "/" + name, std::ios::binary);
+    std::stringstream buffer;
+    buffer << infile.rdbuf();
+    return buffer.str();
+}
+
+static int checkFixtures()
+{
+    int failures = 0;
+    auto expect = [&](const std::string &what, const std::string &got, const std::string &wanted)
+    {
+        bool ok = got == wanted;
+        fmt::print(" * {:<40} {}\n", what, ok ? "OK!" : fmt::format("FAIL! got \"{}\"", got));
+        failures += ok ? 0 : 1;
+    };
+
+    expect("pahe.win, plain link", extractKwikLink(readFixture("pahe_win_direct.html")), "https://kwik.si/f/Ab12Cd34Ef56");
+    expect("pahe.win, packed link", extractKwikLink(readFixture("pahe_win_packed.html")), "https://kwik.si/f/Gh78Ij90Kl12");
+
+    std::string action, token;
+    bool found = extractKwikForm(readFixture("kwik_download.html"), action, token);
+    expect("kwik, form found", found ? "yes" : "no", "yes");
+    expect("kwik, form action", action, "https://kwik.si/d/Gh78Ij90Kl12");
+    expect("kwik, _token", token, "q8Yh2nQp0LmWb3XcR7tZ1vKjE5sGdA9uFoIy4TeN");
+
+    action.clear();
+    token.clear();
+    found = extractKwikForm(readFixture("kwik_without_form.html"), action, token);
+    expect("kwik served without the form", found ? "yes" : "no", "no");
+    return failures;
+}
+
+static int checkRandom(int iterations, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    const std::string symbols = "abcdefhIKNqsVZ0123456789+/";
+    int compared = 0;
+    int mismatches = 0;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        /* arbitrary alphabets, duplicates and digit symbols included */
+        std::string alphabet;
+        for (size_t n = 1 + rng() % 12; alphabet.size() < n;)
+        {
+            alphabet += symbols[rng() % symbols.size()];
+        }
+        const int base = static_cast<int>(rng() % alphabet.size());
+        const int offset = static_cast<int>(rng() % 100);
+
+        std::string encoded;
+        for (size_t n = rng() % 40; encoded.size() < n;)
+        {
+            unsigned pick = rng() % 10;
+            encoded += pick < 6 ? alphabet[rng() % alphabet.size()] : pick < 8 ? symbols[rng() % symbols.size()] : static_cast<char>(rng() % 256);
+        }
+        if (!referenceDefined(encoded, alphabet, base))
+        {
+            continue;
+        }
+
+        compared++;
+        if (!sameDecode(encoded, alphabet, offset, base) && ++mismatches <= 5)
+        {
+            fmt::print(" * mismatch: alphabet \"{}\", base {}, offset {}, payload of {} bytes\n", alphabet, base, offset, encoded.size());
+        }
+    }
+    fmt::print(" * {:<40} {}\n", fmt::format("differential, {} cases", compared), mismatches ? fmt::format("{} FAILED!", mismatches) : "OK!");
+    /* a generator or bound that stops reaching the comparison must not pass silently */
+    if (compared < iterations / 2)
+    {
+        fmt::print(" * only {} of {} cases were compared, FAILED!\n", compared, iterations);
+        mismatches++;
+    }
+
+    /* round trips with alphabets shaped like kwik's: distinct letters, at least one more than the base */
+    int roundTrips = 0;
+    int broken = 0;
+    const std::string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    for (int i = 0; i < iterations / 10; ++i)
+    {
+        std::string pool = letters;
+        std::shuffle(pool.begin(), pool.end(), rng);
+        const std::string alphabet = pool.substr(0, 3 + rng() % 10);
+        /* indices past 9 are written as two digits, the scheme only round-trips up to base 10 */
+        const int base = 2 + static_cast<int>(rng() % (std::min<size_t>(alphabet.size(), 11) - 2));
+        const int offset = static_cast<int>(rng() % 64);
+
+        std::string plain;
+        for (size_t n = rng() % 200; plain.size() < n;)
+        {
+            plain += static_cast<char>(1 + rng() % 255);
+        }
+        roundTrips++;
+        if (decodePackedScript(ReferenceKwik::encode(plain, alphabet, offset, base), alphabet, offset, base) != plain)
+        {
+            broken++;
+        }
+    }
+    fmt::print(" * {:<40} {}\n", fmt::format("round trips, {} payloads", roundTrips), broken ? fmt::format("{} FAILED!", broken) : "OK!");
+    return mismatches + broken;
+}
+
+static void reportThroughput()
+{
+    const std::string alphabet = "hIfKsNVqZa";
+    const int offset = 36;
+    const int base = 5;
+    std::string plain;
+    while (plain.size() < 256 * 1024)
+    {
+        plain += R"(<form action="https://kwik.si/d/Gh78Ij90Kl12" method="POST"><input type="hidden" name="_token" value="q8Yh2nQp0LmWb3XcR7tZ1vKjE5sGdA9uFoIy4TeN"></form>)";
+    }
+    const std::string encoded = ReferenceKwik::encode(plain, alphabet, offset, base);
+    const double megabytes = encoded.size() / (1024.0 * 1024.0);
+
+    fmt::print("\n Throughput, {:.1f} MB encoded\n", megabytes);
+    double reference = measure("reference decoder", [&]()
+    {
+        keep(ReferenceKwik::decodeJSStyle(encoded, alphabet, offset, base));
+    });
+    double current = measure("decodePackedScript", [&]()
+    {
+        keep(decodePackedScript(encoded, alphabet, offset, base));
+    });
+    fmt::print(" * reference decoder  {:>10.1f} MB/s\n", megabytes / (reference / 1e9));
+    fmt::print(" * decodePackedScript {:>10.1f} MB/s\n\n", megabytes / (current / 1e9));
+}
+
+/* fuzz_kwik [iterations] [seed] */
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const unsigned seed = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : std::random_device{}();
+
+    fmt::print("\n Fixtures\n");
+    int failures = checkFixtures();
+    fmt::print("\n Decoder, seed {}\n", seed);
+    failures += checkRandom(iterations, seed);
+    if (failures)
+    {
+        return 1;
+    }
+    reportThroughput();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+/**
+ * The kwik decoder as it was before decodePackedScript, kept verbatim as the
+ * reference the benchmarks and the differential harness compare against, and
+ * the encoder kwik uses, to build payloads for them. */
+#include <cmath>
+#include <string>
+
+namespace ReferenceKwik
+{
+    inline const std::string baseAlphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/";
+
+    inline int _0xe16c(const std::string &IS, int Iy, int ms)
+    {
+        std::string h = baseAlphabet.substr(0, Iy);
+        std::string i = baseAlphabet.substr(0, ms);
+
+        int j = 0;
+        for (int idx = 0; idx < IS.size(); ++idx)
+        {
+            char ch = IS[IS.size() - 1 - idx];
+            size_t pos = h.find(ch);
+            if (pos != std::string::npos)
+            {
+                j += static_cast<int>(pos) * static_cast<int>(std::pow(Iy, idx));
+            }
+        }
+
+        if (j == 0)
+            return i[0];
+
+        std::string k;
+        while (j > 0)
+        {
+            k = i[j % ms] + k;
+            j /= ms;
+        }
+
+        return std::stoi(k);
+    }
+
+    inline std::string decodeJSStyle(const std::string &Hb, const std::string &Wg, int Of, int Jg)
+    {
+        std::string gj;
+
+        for (size_t i = 0; i < Hb.size(); ++i)
+        {
+            std::string s;
+            while (Hb[i] != Wg[Jg])
+            {
+                s += Hb[i];
+                i++;
+                if (i >= Hb.size())
+                    break;
+            }
+
+            for (size_t j = 0; j < Wg.size(); ++j)
+            {
+                std::string from(1, Wg[j]);
+                std::string to = std::to_string(j);
+                size_t pos;
+                while ((pos = s.find(from)) != std::string::npos)
+                {
+                    s.replace(pos, 1, to);
+                }
+            }
+
+            int code = _0xe16c(s, Jg, 10) - Of;
+            gj += static_cast<char>(code);
+        }
+
+        return gj;
+    }
+
+    /* packs text as kwik does: each character plus offset in base digits, one alphabet symbol per digit */
+    inline std::string encode(const std::string &plain, const std::string &alphabet, int offset, int base)
+    {
+        std::string out;
+        for (unsigned char c : plain)
+        {
+            std::string digits;
+            for (int v = c + offset; v > 0; v /= base)
+            {
+                digits.insert(digits.begin(), alphabet[v % base]);
+            }
+            out += digits;
+            out += alphabet[base];
+        }
+        return out;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/* sanitize_utf8 as it was before the vectorized scan, kept verbatim as the reference bench_utf8 compares against */
+#include <string>
+
+namespace ReferenceUtf8
+{
+    inline std::string sanitize_utf8(const std::string &input)
+    {
+        std::string output;
+        output.reserve(input.size());
+
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(input.data());
+        size_t len = input.size();
+
+        for (size_t i = 0; i < len;)
+        {
+            unsigned char byte = data[i];
+
+            if (byte <= 0x7F)
+            {
+                output += byte;
+                i++;
+            }
+            else if ((byte >> 5) == 0x6 && i + 1 < len &&
+                     (data[i + 1] & 0xC0) == 0x80)
+            {
+                output.append(reinterpret_cast<const char *>(&data[i]), 2);
+                i += 2;
+            }
+            else if ((byte >> 4) == 0xE && i + 2 < len &&
+                     (data[i + 1] & 0xC0) == 0x80 &&
+                     (data[i + 2] & 0xC0) == 0x80)
+            {
+                output.append(reinterpret_cast<const char *>(&data[i]), 3);
+                i += 3;
+            }
+            else if ((byte >> 3) == 0x1E && i + 3 < len &&
+                     (data[i + 1] & 0xC0) == 0x80 &&
+                     (data[i + 2] & 0xC0) == 0x80 &&
+                     (data[i + 3] & 0xC0) == 0x80)
+            {
+                output.append(reinterpret_cast<const char *>(&data[i]), 4);
+                i += 4;
+            }
+            else
+            {
+                // invalid byte, skip
+                i++;
+            }
+        }
+
+        return output;
+    }
+}
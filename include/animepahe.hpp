@@ -4,29 +4,96 @@
 #define ANIMEPAHE_HPP
 
 #include <cpr/cpr.h>
+#include <sessionpool.hpp>
+#include <downloader.hpp>
+#include <manifest.hpp>
+#include <episodesource.hpp>
+#include <functional>
+#include <utility>
+#include <chrono>
 #include <map>
 #include <vector>
 #include <string>
 
 namespace AnimepaheCLI
 {
+    struct ExtractOptions
+    {
+        /* play pages fetched at the same time */
+        int pageWorkers = 4;
+        /* kwik links resolved at the same time */
+        int resolveWorkers = 2;
+        /* serve pages and API responses from the on-disk cache, see HttpCache */
+        bool useCache = true;
+    };
+
+    /* First page of the release API, read once and reused by fetch_series */
+    struct ReleaseInfo
+    {
+        std::string id;
+        int total = 0;
+        int perPage = 30;
+        int lastPage = 1;
+        /* play pages listed on page 1 */
+        std::vector<std::string> firstPage;
+    };
+
+    /* An episode whose kwik link has been resolved to a direct download */
+    struct ResolvedEpisode
+    {
+        int number = 0;
+        /* play page the stream was picked from */
+        std::string page;
+        /* resolution and audio that were asked for, see requestVariant */
+        std::string variant;
+        /* pahe.win link it was resolved from */
+        std::string source;
+        std::string directLink;
+    };
+
     class Animepahe
     {
     private:
+        ExtractOptions options_;
+        /* play pages waiting for the resolver */
+        static const size_t PIPELINE_DEPTH = 8;
+        /* how long cached responses are used without asking the server */
+        static constexpr std::chrono::hours SERIES_PAGE_TTL{24};
+        static constexpr std::chrono::hours PLAY_PAGE_TTL{72};
+        static constexpr std::chrono::hours FULL_RELEASE_PAGE_TTL{24 * 30};
+
         cpr::Header getHeaders(const std::string &link);
-        std::map<std::string, std::string> fetch_episode(const std::string &link, const int &targetRes, const std::string &audioLang);
-        int get_series_episode_count(const std::string& link);
-        std::vector<std::string> fetch_series(const std::string &link, const int epCount, bool isAllEpisodes, const std::vector<int> &episodes);
+        /* pooled session set up with the site headers, cookies and any conditional headers */
+        SessionPool::Lease openSession(const std::string &url, const std::string &link, const cpr::Header &conditional);
+        /* GET through the response cache and the shared session pool with the site headers and cookies, ttl 0 always revalidates */
+        cpr::Response request(const std::string &url, const std::string &link, std::chrono::seconds ttl = std::chrono::seconds(0));
+        /* the source on a play page that best matches the wanted resolution and language */
+        EpisodeSource fetch_episode(const std::string &link, const int targetRes, const AudioLang audioLang);
+        /* play page links listed on one release API page */
+        std::vector<std::string> fetch_release_page(const std::string &link, const std::string &id, int page, std::chrono::seconds ttl);
+        ReleaseInfo fetch_release_info(const std::string &link);
+        std::vector<std::string> fetch_series(const std::string &link, const ReleaseInfo &info, bool isAllEpisodes, const std::vector<int> &episodes);
         std::string extract_link_metadata(const std::string &link, bool isSeries);
-        std::vector<std::map<std::string, std::string>> extract_link_content(
+        /* episode number and play page of every requested episode */
+        std::vector<std::pair<int, std::string>> list_episode_pages(
             const std::string &link,
             const std::vector<int> &episodes,
-            const int targetRes,
-            const std::string &audioLang,
             bool isSeries,
             bool isAllEpisodes
         );
+        /* direct link for a pahe.win source, from the link cache while it is valid */
+        std::string resolve_direct_link(const std::string &source, bool *cached = nullptr);
+        /* fetch play pages and resolve kwik links as a pipeline, sink() gets each link as soon as it exists */
+        std::vector<ResolvedEpisode> resolve_episodes(
+            const std::vector<std::pair<int, std::string>> &pages,
+            const int targetRes,
+            const std::string &audioLang,
+            const Manifest *finished,
+            const std::function<void(const std::string &)> &log,
+            const std::function<void(const ResolvedEpisode &)> &sink
+        );
     public:
+        void setOptions(const ExtractOptions &options);
         void extractor(
             bool isSeries,
             const std::string &link,
@@ -37,7 +104,8 @@ namespace AnimepaheCLI
             const std::string &export_filename,
             bool exportLinks = false,
             bool createZip = false,
-            bool removeSource = false
+            bool removeSource = false,
+            const DownloadOptions &downloadOptions = {}
         );
     };
 }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+/**
+ * Blocking FIFO with a fixed capacity, the hand-off between two pipeline stages.
+ * A full queue holds the producer back, so a fast stage cannot run far ahead
+ * of a slow one; close() lets consumers drain what is left and stop. */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    /* waits for room, false if the queue was closed */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        notFull_.wait(lock, [this]()
+        {
+            return closed_ || items_.size() < capacity_;
+        });
+        if (closed_)
+        {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /* waits for an item, false once the queue is closed and drained */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        notEmpty_.wait(lock, [this]()
+        {
+            return closed_ || !items_.empty();
+        });
+        if (items_.empty())
+        {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mtx_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * CRC-64/XZ of downloaded content.
+ * Checksums of adjacent byte ranges can be combined without the data, so
+ * segments that arrive out of order or across runs still add up to the
+ * checksum of the whole file, computed while the bytes arrive. */
+class Crc64
+{
+public:
+    /* continue crc (0 for an empty prefix) with size more bytes */
+    static uint64_t update(uint64_t crc, const char *data, size_t size);
+    /* checksum of A followed by B, from the checksums of A and B and the length of B */
+    static uint64_t combine(uint64_t first, uint64_t second, size_t secondLength);
+    /* "crc64:<16 hex digits>", the form kept in the manifest */
+    static std::string format(uint64_t crc);
+
+    /* the step combine() applies to the first checksum, precomputed for one fixed length */
+    class Shift
+    {
+    public:
+        explicit Shift(size_t length);
+        uint64_t apply(uint64_t crc) const;
+
+    private:
+        uint64_t rows_[64];
+    };
+};
@@ -1,20 +1,156 @@
+#pragma once
+
 #include <cpr/cpr.h>
+#include "ratelimiter.hpp"
+#include "progress.hpp"
+#include "retrypolicy.hpp"
+#include "manifest.hpp"
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+enum class DownloadOrder
+{
+    Episode,      /* as requested */
+    LargestFirst  /* parallel transfers finish close together */
+};
+
+struct DownloadOptions
+{
+    /* parallel range requests per file, 0 = auto-tune */
+    int connections = 1;
+    /* episodes transferred at the same time */
+    int parallelDownloads = 1;
+    DownloadOrder order = DownloadOrder::Episode;
+    /* bytes per second across all transfers, 0 = unlimited */
+    size_t rateLimit = 0;
+    /* time-of-day limits that override rateLimit */
+    std::vector<RateWindow> rateSchedule;
+};
+
+/* Where a download came from, recorded in the manifest */
+struct DownloadOrigin
+{
+    /* pahe.win link the url was resolved from, also what a rejected url is resolved again from */
+    std::string source;
+    /* play page of the episode */
+    std::string page;
+    /* resolution and audio it was picked for */
+    std::string variant;
+};
 
 class Downloader {
 public:
     Downloader(const std::vector<std::string>& urls);
     void setDownloadDirectory(const std::string& dir);
+    void setOptions(const DownloadOptions& options);
+    /* origin of each url, recorded in the manifest */
+    void setSources(const std::vector<DownloadOrigin>& sources);
+    /* turns a source back into a fresh direct link when the server rejects an expired one (403/410) */
+    void setLinkResolver(std::function<std::string(const std::string&)> resolver);
     void startDownloads();
 
+    /**
+     * Pipelined use: open() starts the download workers, enqueue() hands over
+     * files as their links are resolved and close() waits for the last one.
+     * Space is admitted per file and --order is ignored, the batch is not known up front. */
+    void open();
+    /* blocks while parallelDownloads files are already waiting for a slot */
+    void enqueue(const std::string& url, const DownloadOrigin& origin);
+    void close();
+    /* print a line above the download dashboard */
+    void log(const std::string& message);
+
 private:
+    struct RemoteInfo
+    {
+        size_t size = 0;
+        bool acceptsRanges = false;
+        std::string etag;
+        std::string lastModified;
+    };
+
+    struct DownloadJob
+    {
+        std::string url;
+        std::string filename;
+        std::string filepath;
+        std::string source;
+        std::string page;
+        std::string variant;
+        size_t expectedSize = 0;
+        /* probed before the batch starts, reused by the first attempt */
+        RemoteInfo remote;
+        /* retry state, transient failures only */
+        int attempts = 0;
+        Backoff backoff;
+        std::chrono::steady_clock::time_point notBefore;
+        /* set by a finished download, see Crc64::format */
+        std::string checksum;
+        /* url was replaced after the server rejected the first one */
+        bool relinked = false;
+    };
+
     std::vector<std::string> urls_;
+    std::vector<DownloadOrigin> sources_;
+    std::function<std::string(const std::string&)> resolver_;
     std::string download_dir_;
+    /* finished files in download_dir_, skipped on later runs */
+    std::unique_ptr<Manifest> manifest_;
+    DownloadOptions options_;
+    /* dashboard and console output while downloads run */
+    ProgressBoard progress_;
     static const int MAX_RETRIES = 3;
+    static const int MAX_CONNECTIONS = 16;
+    /* files smaller than this are not worth splitting */
+    static const size_t MIN_SEGMENT_SIZE = 1024 * 1024;
+    /* segment size used while auto-tuning the connection count */
+    static const size_t AUTO_SEGMENT_SIZE = 4 * 1024 * 1024;
+    /* bytes received between sidecar updates */
+    static const size_t SIDECAR_INTERVAL = 4 * 1024 * 1024;
+    /* free space left alone when admitting a batch */
+    static const size_t FREE_SPACE_MARGIN = 256 * 1024 * 1024;
+
+    /* Worker state shared by runJobs and the pipelined open()/enqueue()/close() */
+    std::mutex mtx_; /* guards everything below */
+    std::condition_variable cv_;
+    /* every job of the run, a deque so queued pointers stay valid as it grows */
+    std::deque<DownloadJob> jobs_;
+    std::deque<DownloadJob*> queue_;
+    std::vector<std::thread> workers_;
+    /* more jobs may still be enqueued */
+    bool accepting_ = false;
+    bool batch_ = false;
+    int active_ = 0;
+    size_t failures_ = 0;
+    std::chrono::steady_clock::time_point startTime_;
+    size_t startBytes_ = 0;
+    /* pipelined admission, bytes promised to enqueued files out of what was free at open() */
+    bool spaceKnown_ = false;
+    size_t available_ = 0;
+    size_t committed_ = 0;
 
     std::string extractFilename(const std::string& url) const;
-    bool downloadFile(const std::string& url, const std::string& filepath);
-    bool downloadFileWithRetry(const std::string& url, const std::string& filepath, int retries);
+    DownloadJob makeJob(const std::string& url, const DownloadOrigin& origin) const;
+    void probeJobs(std::vector<DownloadJob>& jobs);
+    bool admitJobs(std::vector<DownloadJob>& jobs);
+    void orderJobs(std::vector<DownloadJob>& jobs);
+    size_t remainingBytes(const DownloadJob& job) const;
+    void runJobs(std::vector<DownloadJob>& jobs, int workers);
+    /* spawn workers that take jobs from queue_ until it drains and accepting_ is cleared */
+    void startWorkers(int workers, size_t expectedJobs);
+    void joinWorkers();
+    void workerLoop();
+    RemoteInfo probeRemote(const std::string& url) const;
+    RequestResult downloadFile(DownloadJob& job);
+    RequestResult downloadSingleStream(DownloadJob& job);
+    RequestResult downloadSegmented(DownloadJob& job, const RemoteInfo& remote);
 };
@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef EPISODESOURCE_HPP
+#define EPISODESOURCE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    enum class AudioLang : uint8_t
+    {
+        Japanese,
+        English,
+        Chinese,
+        Other /* a language tag the menu has no option for */
+    };
+
+    /* jp, en or zh as given to -a,--audio */
+    AudioLang parseAudioLang(const std::string &audio);
+
+    /* One entry of a play page's download menu */
+    struct EpisodeSource
+    {
+        /* pahe.win link the direct download is resolved from */
+        std::string link;
+        /* vertical resolution, 0 when the entry does not say */
+        int resolution = 0;
+        AudioLang lang = AudioLang::Japanese;
+        bool bluray = false;
+
+        bool operator==(const EpisodeSource &other) const = default;
+    };
+
+    /**
+     * A play page's sources grouped by language, each group ordered by
+     * resolution, built once per page so picking a source is a lookup. */
+    class SourceIndex
+    {
+    public:
+        explicit SourceIndex(const std::vector<EpisodeSource> &sources);
+
+        /**
+         * Source in the wanted language, or any language when it has none,
+         * at targetRes: 0 the highest, -1 the lowest, otherwise that exact
+         * resolution or else the highest. nullptr when there are no sources. */
+        const EpisodeSource *select(AudioLang lang, int targetRes) const;
+
+    private:
+        static constexpr size_t LANG_COUNT = static_cast<size_t>(AudioLang::Other) + 1;
+
+        const std::vector<EpisodeSource> &sources_;
+        /* positions in sources_, highest resolution first, menu order among equals */
+        std::array<std::vector<uint16_t>, LANG_COUNT> byLang_;
+        std::vector<uint16_t> all_;
+
+        const EpisodeSource *pick(const std::vector<uint16_t> &group, int targetRes) const;
+    };
+}
+
+#endif
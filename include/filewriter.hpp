@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Large aligned buffers shared by all transfers and the writer thread.
+ * The pool grows on demand up to a cap that rises with every open stream,
+ * so a stream can always get a buffer while others wait on the disk. */
+class BufferPool
+{
+public:
+    static const size_t BUFFER_SIZE = 1024 * 1024;
+    static const size_t ALIGNMENT = 4096;
+
+    ~BufferPool();
+
+    /* blocks while every buffer is in use */
+    char *acquire();
+    void release(char *buffer);
+
+    void addStream();
+    void removeStream();
+
+private:
+    /* buffers kept in flight beyond the ones being filled */
+    static const size_t BASE_BUFFERS = 8;
+
+    std::vector<char *> free_;
+    size_t allocated_ = 0;
+    size_t streams_ = 0;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+
+    size_t capacity() const { return BASE_BUFFERS + 2 * streams_; }
+};
+
+/**
+ * Background writer for downloads.
+ * Transfers copy network chunks straight into pooled buffers through a Stream,
+ * full buffers are written at their file offset by one writer thread using
+ * positional writes, or io_uring on Linux when built with ANIMEPAHE_WITH_IO_URING. */
+class FileWriter
+{
+public:
+    /* One open file, shared by every stream writing into it */
+    class Target
+    {
+    public:
+        ~Target();
+        bool isOpen() const;
+        /**
+         * Grow the file to size with its blocks allocated up front, so it is laid out
+         * contiguously and a full disk shows up here instead of mid-download.
+         * Never shrinks the file. */
+        bool reserve(size_t size);
+        /* false once any write into this file failed */
+        bool ok() const { return !failed_; }
+
+    private:
+        friend class FileWriter;
+#ifdef _WIN32
+        void *handle_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+        std::atomic<bool> failed_{false};
+    };
+
+    /* Sequential bytes from one transfer into a Target, starting at an offset */
+    class Stream
+    {
+    public:
+        Stream(std::shared_ptr<Target> target, size_t offset);
+        ~Stream();
+        Stream(const Stream &) = delete;
+        Stream &operator=(const Stream &) = delete;
+
+        /* copies into the current buffer, hands it to the writer when full */
+        bool append(const char *data, size_t size);
+        /* submit the partial buffer and wait until this stream's bytes are on disk */
+        bool finish();
+        /* bytes from the start offset known to be written */
+        size_t durable() const { return state_->durable; }
+        /**
+         * CRC-64 of bytes [from, to) relative to the start offset, taken from each buffer
+         * as it is handed to the writer. Both ends must be durable() values or the total. */
+        uint64_t checksum(size_t from, size_t to) const;
+
+    private:
+        struct State
+        {
+            std::atomic<size_t> durable{0};
+            std::atomic<size_t> pending{0};
+        };
+
+        std::shared_ptr<Target> target_;
+        std::shared_ptr<State> state_;
+        size_t offset_;
+        char *buffer_ = nullptr;
+        size_t filled_ = 0;
+        /* checksum of every submitted buffer, all full but the last */
+        std::vector<uint64_t> checksums_;
+
+        void submit();
+        friend class FileWriter;
+    };
+
+    static FileWriter &instance();
+    ~FileWriter();
+
+    /* open for positional writes without truncating */
+    std::shared_ptr<Target> open(const std::string &path);
+
+private:
+    struct Request
+    {
+        std::shared_ptr<Target> target;
+        std::shared_ptr<Stream::State> state;
+        char *buffer;
+        size_t offset;
+        size_t length;
+    };
+
+    FileWriter();
+    void enqueue(Request request);
+    void run();
+    void writeBatch(std::vector<Request> &batch);
+    static bool writeAt(Target &target, const char *data, size_t length, size_t offset);
+    void complete(Request &request, bool ok);
+    void waitFor(const Stream::State &state);
+
+    BufferPool pool_;
+    std::deque<Request> queue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable done_;
+    bool stopping_ = false;
+    std::thread thread_;
+    /* io_uring instance when available, nullptr otherwise */
+    void *ring_ = nullptr;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#ifndef HTMLENTITIES_HPP
+#define HTMLENTITIES_HPP
+
+#include <string>
+#include <string_view>
+
+namespace AnimepaheCLI
+{
+    /**
+     * UTF-8 of a named character reference, name given without the '&' and
+     * with its ';' (legacy references also match without one). Empty when
+     * HTML has no such reference. */
+    std::string_view lookupHtmlEntity(std::string_view name);
+
+    /**
+     * Decodes the character references in text in place, numeric and named
+     * (the HTML5 list, semicolon-less legacy names included), as a browser
+     * would: invalid code points become U+FFFD and &#128;-&#159; map through
+     * Windows-1252. Text without '&' is left alone after one scan. Pass
+     * attribute for attribute values, where a legacy name followed by '=' or
+     * a letter or digit stays as written, so query strings survive. */
+    void decodeHtmlEntities(std::string &text, bool attribute = false);
+}
+
+#endif
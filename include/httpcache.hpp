@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cpr/cpr.h>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * On-disk cache of site pages and API responses, one file per URL.
+ * A response younger than the TTL the caller passes is served without a
+ * request; an older one is revalidated with If-None-Match / If-Modified-Since
+ * and a 304 keeps the stored body. Only 200 responses without an error are
+ * stored, so send() keeps a response out of the cache by setting one.
+ * Once per run, entries not stored or revalidated for MAX_AGE are removed,
+ * then the oldest ones until the cache fits in MAX_SIZE. */
+class HttpCache
+{
+public:
+    static HttpCache &instance();
+
+    /* off: every call goes to the network and nothing is read or stored */
+    void setEnabled(bool enabled);
+    void setDirectory(const std::string &directory);
+    /* <user cache directory>/animepahe-cli, empty if there is none */
+    static std::string defaultDirectory();
+
+    /* send() gets the conditional headers to add, empty when there is nothing to revalidate */
+    cpr::Response get(const std::string &url, std::chrono::seconds ttl, const std::function<cpr::Response(const cpr::Header &)> &send);
+
+private:
+    /* the longest TTL any caller passes, an older entry could only be revalidated */
+    static constexpr std::chrono::hours MAX_AGE{24 * 30};
+    static const uintmax_t MAX_SIZE = 256ull * 1024 * 1024;
+    /* a temp file this old was left by a process that died before the rename */
+    static constexpr std::chrono::hours TEMP_MAX_AGE{1};
+
+    struct Entry
+    {
+        std::string url;
+        std::string etag;
+        std::string lastModified;
+        /* seconds since the epoch when the body was last known to be current */
+        long long storedAt = 0;
+        std::string body;
+    };
+
+    std::mutex mtx_; /* guards the settings, entries are written aside and renamed */
+    bool enabled_ = true;
+    std::string directory_;
+    bool swept_ = false;
+
+    HttpCache();
+    std::string pathFor(const std::string &url) const;
+    /* never throws, an unreadable entry is a miss */
+    bool load(const std::string &directory, const std::string &url, Entry &entry) const;
+    bool read(const std::string &directory, const std::string &url, Entry &entry) const;
+    /* never throws, a cache that cannot be written is only slower */
+    void store(const std::string &directory, const Entry &entry) const;
+    void write(const std::string &directory, const Entry &entry) const;
+    static cpr::Response respond(const Entry &entry);
+    /* never throws, only touches files named like entries */
+    void sweep(const std::string &directory) const;
+    void trim(const std::string &directory) const;
+};
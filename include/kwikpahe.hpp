@@ -4,18 +4,44 @@
 #define KWIKPAHE_HPP
 
 #include <string>
+#include <cpr/cpr.h>
 
 namespace AnimepaheCLI
 {
+    /**
+     * Resolves pahe.win links to direct downloads.
+     * Holds no state between calls, one instance can be shared by any number of threads. */
     class KwikPahe
     {
     private:
-        int _0xe16c(const std::string &IS, int Iy, int ms);
-        std::string decodeJSStyle(const std::string &Hb, int zp, const std::string &Wg, int Of, int Jg, int gj_placeholder);
-        std::string fetch_kwik_dlink(const std::string& kwikLink, int retries = 5); 
-        std::string fetch_kwik_direct(const std::string &kwikLink, const std::string &token, const std::string &kwik_session);
+        /**
+         * How far one kwik link has been resolved. Lives on the resolving call's
+         * stack; a failed step is retried from here, so the page, token and
+         * kwik_session are only fetched again when kwik no longer accepts them. */
+        struct Resolution
+        {
+            enum Stage
+            {
+                FetchPage,  /* GET the kwik page, keeping its kwik_session cookie */
+                ReadForm,   /* decode the page's packed script for the form action and _token */
+                PostForm,   /* POST the token, the 302 carries the direct link */
+                Done
+            } stage = FetchPage;
+
+            std::string page;
+            std::string session;
+            std::string action;
+            std::string token;
+            std::string location;
+        };
+
+        /* GET through the shared session pool, Set-Cookie is read by the caller */
+        cpr::Response get(const std::string &link) const;
+        std::string fetch_kwik_dlink(const std::string& kwikLink, int retries = 5) const;
+        /* one POST of the form, the caller decides what a failure means for the next step */
+        cpr::Response post_kwik_form(const std::string &kwikLink, const Resolution &resolution) const;
     public:
-        std::string extract_kwik_link(const std::string& link);
+        std::string extract_kwik_link(const std::string& link) const;
     };
 }
 
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+
+/**
+ * Direct links resolved from pahe.win pages, kept across runs (links.json in
+ * the cache directory) so a retry, an export followed by a download or another
+ * pass skips the Kwik round trips. Kwik links stop working after a while: an
+ * entry is served only while it should still be valid, judged by the link's own
+ * expires= parameter or else by the shortest lifetime among the links the
+ * server has rejected recently. */
+class LinkCache
+{
+public:
+    static LinkCache &instance();
+
+    /* off: lookups miss and nothing is stored */
+    void setEnabled(bool enabled);
+
+    /* a direct link for source that should still be valid, empty if there is none */
+    std::string lookup(const std::string &source);
+    void store(const std::string &source, const std::string &link);
+    /* the server refused the link (403/410), drop it and learn from its age */
+    void reject(const std::string &source);
+
+private:
+    /* lifetime assumed before any link has been seen to expire */
+    static constexpr std::chrono::hours DEFAULT_LIFETIME{1};
+    /* a link this close to expiring is not handed out, a download needs time to start */
+    static constexpr std::chrono::minutes MARGIN{2};
+    /* rejections the lifetime is judged by, so one early expiry does not shorten every later link for good */
+    static const size_t REJECTION_WINDOW = 8;
+    static constexpr std::chrono::hours REJECTION_MAX_AGE{24 * 7};
+
+    struct Entry
+    {
+        std::string link;
+        long long resolvedAt = 0;
+        /* from the link itself, 0 when it carries no expiry */
+        long long expires = 0;
+    };
+
+    std::mutex mtx_;
+    bool enabled_ = true;
+    bool loaded_ = false;
+    std::string path_;
+    std::map<std::string, Entry> entries_;
+
+    struct Rejection
+    {
+        long long rejectedAt = 0;
+        /* seconds between resolving the link and the server refusing it */
+        long long age = 0;
+    };
+    /* recent rejections of links without an expiry of their own, oldest first */
+    std::deque<Rejection> rejections_;
+
+    LinkCache();
+    void load();
+    void read();
+    void save() const;
+    /* shortest lifetime among recent rejections in seconds, 0 while there are none */
+    long long observedLifetime() const;
+    long long expiresAt(const Entry &entry) const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+
+/* One finished download as recorded in the manifest */
+struct ManifestEntry
+{
+    std::string filename;
+    size_t size = 0;
+    /* "crc64:<hex>" computed while downloading, empty if part of the file predates checksums */
+    std::string hash;
+    /* where the bytes came from */
+    std::string url;
+    /* pahe.win link the url was resolved from, lets a re-run skip before resolving */
+    std::string source;
+    /* play page the episode was picked from, lets a re-run skip before any request for it */
+    std::string page;
+    /* resolution and audio asked for on that page, a page only counts for the same request */
+    std::string variant;
+    /* modification time of the file when recorded, a cheap check that it was not replaced */
+    long long modified = 0;
+};
+
+/**
+ * Per-directory record of completed downloads (.animepahe-manifest.json).
+ * An entry counts only while the file next to it still has the recorded size
+ * and modification time, so a re-run can skip it without reading it back. */
+class Manifest
+{
+public:
+    static const char *FILENAME;
+
+    explicit Manifest(const std::string &directory);
+
+    /* finished and unchanged on disk */
+    bool contains(const std::string &filename) const;
+    bool containsSource(const std::string &source) const;
+    bool containsPage(const std::string &page, const std::string &variant) const;
+
+    /* size and modification time are taken from the file itself */
+    bool record(ManifestEntry entry);
+
+private:
+    std::string directory_;
+    mutable std::mutex mtx_;
+    std::map<std::string, ManifestEntry> entries_;
+
+    bool onDisk(const ManifestEntry &entry) const;
+    bool save() const;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef PARSERS_HPP
+#define PARSERS_HPP
+
+#include <episodesource.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Download options of a play page read straight off the response body.
+     * Chunks are fed as they arrive and scanned once for pahe.win anchors; only
+     * an anchor that is still incomplete is carried over to the next chunk. The
+     * anchors sit together in the download menu, so the first </div> after them
+     * ends the scan and the rest of the page never has to be received. */
+    class PlayPageScanner
+    {
+    public:
+        /* false once the download menu has been read, the transfer can stop */
+        bool feed(std::string_view chunk);
+        bool done() const { return done_; }
+        /* the menu was read to its end and listed at least one source, only then is section() worth keeping */
+        bool complete() const { return done_ && !sources_.empty(); }
+
+        /* one per anchor, in menu order */
+        const std::vector<EpisodeSource> &sources() const { return sources_; }
+        /* the anchors as they appeared, scanning this again gives the same sources */
+        const std::string &section() const { return section_; }
+
+    private:
+        std::string pending_;
+        std::vector<EpisodeSource> sources_;
+        std::string section_;
+        bool done_ = false;
+
+        void parseAnchor(std::string_view anchor);
+    };
+
+    /* PlayPageScanner over a page that is already in memory */
+    std::vector<EpisodeSource> parsePlayPage(std::string_view html);
+
+    /* The parts of a release API page that are used, 0 where the page does not say */
+    struct ReleasePage
+    {
+        int total = 0;
+        int perPage = 0;
+        int lastPage = 0;
+        /* play page session of every listed episode, empty where an entry has none */
+        std::vector<std::string> sessions;
+    };
+
+    /**
+     * Reads a release API payload with a SAX handler that keeps total,
+     * per_page, last_page and data[].session and skips everything else without
+     * building a document. False when the payload is not valid JSON; page
+     * then holds whatever was read before the error. */
+    bool parseReleasePage(std::string_view payload, ReleasePage &page);
+
+    /**
+     * Decodes the payload of the packed script on kwik pages: tokens split by
+     * alphabet[base], each symbol standing for its alphabet index, read as a
+     * number in the given base and shifted down by offset to a character. */
+    std::string decodePackedScript(std::string_view encoded, std::string_view alphabet, int offset, int base);
+
+    /* Arguments of the packed script kwik and pahe.win pages carry */
+    struct PackedScript
+    {
+        std::string encoded;
+        std::string alphabet;
+        int offset = 0;
+        int base = 0;
+    };
+
+    /* false when the text has no packed script */
+    bool findPackedScript(const std::string &text, PackedScript &script);
+
+    /**
+     * Kwik page a pahe.win page leads to, taken from the page or else from its
+     * decoded packed script (with /d/ turned into /f/). Throws when there is none. */
+    std::string extractKwikLink(const std::string &html);
+
+    /* action and _token of the download form in a kwik page's packed script, false when the page came without them */
+    bool extractKwikForm(const std::string &html, std::string &action, std::string &token);
+}
+
+#endif
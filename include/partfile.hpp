@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+/**
+ * Sidecar kept next to an unfinished download (<name>.part.meta).
+ * Records where the bytes of <name>.part came from, so a retry or a later run
+ * can continue with a Range request instead of starting over. */
+struct PartFile
+{
+    /* finished range of a segmented download, inclusive, with the CRC-64 of its bytes */
+    struct Segment
+    {
+        size_t begin;
+        size_t end;
+        uint64_t checksum;
+    };
+
+    std::string url;
+    std::string etag;
+    std::string lastModified;
+    size_t totalSize = 0;
+    /* contiguous bytes written by a single stream, and their CRC-64 */
+    size_t bytesWritten = 0;
+    uint64_t checksum = 0;
+    /* finished ranges of a segmented download, sorted and merged */
+    std::vector<Segment> segments;
+    /* false when bytes on disk came from a sidecar written before checksums were kept */
+    bool checksummed = true;
+
+    static std::string partPath(const std::string& filepath);
+    static std::string metaPath(const std::string& filepath);
+
+    bool load(const std::string& filepath);
+    bool save(const std::string& filepath) const;
+
+    /* If-Range value, ETag preferred over Last-Modified */
+    std::string validator() const;
+
+    /* merge a finished range into segments */
+    void addSegment(size_t begin, size_t end, uint64_t checksum);
+    /* ranges still missing from segments, inclusive */
+    std::vector<std::pair<size_t, size_t>> missingSegments() const;
+    size_t segmentBytes() const;
+
+    /* move <name>.part over <name> and drop the sidecar */
+    static bool complete(const std::string& filepath);
+    /* forget the partial download entirely */
+    static void discard(const std::string& filepath);
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef PATTERNS_HPP
+#define PATTERNS_HPP
+
+#include <re2/re2.h>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Every RE2 pattern the page, API and Kwik parsers use, compiled once.
+     * Passing a string literal to RE2::FindAndConsume and friends builds and
+     * discards an RE2 object per call; these are built on first use of get()
+     * and, being immutable, are shared by all worker threads without locking. */
+    struct Patterns
+    {
+        /* line breaks, stripped before matching */
+        const RE2 newline{R"((\r\n|\r|\n))"};
+
+        /* series and play page metadata */
+        const RE2 seriesTitle{R"re(style=[^=]+title="([^"]+)")re"};
+        const RE2 seriesType{R"re(Type:[^>]*title="[^"]*"[^>]*>([^<]+)</a>)re"};
+        const RE2 seriesEpisodes{R"re(Episode[^>]*>\s*(\S*)</p)re"};
+        const RE2 episodeTitle{R"re(title="[^>]*>([^<]*)</a>\D*(\d*)<span)re"};
+        const RE2 seriesId{R"(anime/([a-f0-9-]{36}))"};
+
+        /* kwik */
+        const RE2 packedScript{R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re"};
+        const RE2 kwikLink{R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re"};
+        const RE2 kwikDownloadPath{R"re((https:\/\/kwik\.[^\/]+\/)d\/)re"};
+        const RE2 formToken{R"re(name="_token"[^"]*"(\S*)">)re"};
+        const RE2 kwikSession{R"re(kwik_session=([^;]*);)re"};
+        const RE2 location{R"re(ocation:\s*(https?://\S+))re"};
+
+        /* resolved direct links */
+        const RE2 linkExpires{R"([?&]expires=(\d{9,11})(?:&|$))"};
+
+        static const Patterns &get()
+        {
+            static const Patterns patterns;
+            return patterns;
+        }
+    };
+}
+
+#endif
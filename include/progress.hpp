@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+std::string formatTime(double totalSeconds);
+std::string formatSpeedMB(double bytesPerSecond);
+std::string formatSizeMB(size_t bytes);
+
+/* Counters one transfer publishes to, written lock-free from its callbacks */
+struct ProgressSlot
+{
+    std::string label;
+    /* 0 while unknown */
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> done{0};
+};
+
+/**
+ * Console dashboard for running downloads.
+ * Transfers only bump atomics in their ProgressSlot, a render thread redraws one
+ * line per transfer plus a summary line at a fixed frame rate, with EWMA-smoothed
+ * speed and ETA. Messages go through log() so they land above the dashboard. */
+class ProgressBoard
+{
+public:
+    ~ProgressBoard();
+
+    void start();
+    /* clears the dashboard, the cursor is left on the last logged line */
+    void stop();
+
+    /* the line disappears once the caller drops the slot */
+    std::shared_ptr<ProgressSlot> add(const std::string &label, size_t total = 0, size_t done = 0);
+
+    /* print a line above the dashboard */
+    void log(const std::string &message);
+
+    /* files in this run, the summary line is shown when there is more than one */
+    void setJobs(size_t jobs);
+    /* one more file in this run, for runs that learn their files as they go */
+    void addJob();
+    void jobFinished();
+
+    /* bytes received by every transfer */
+    std::atomic<size_t> received{0};
+
+private:
+    static constexpr std::chrono::milliseconds FRAME_INTERVAL{100};
+    /* time constant of the speed average, in seconds */
+    static constexpr double SMOOTHING = 2.0;
+    static const size_t LABEL_WIDTH = 40;
+
+    /* Smoothed rate of one counter, only touched by the render thread */
+    struct Meter
+    {
+        size_t last = 0;
+        double rate = 0.0;
+        bool primed = false;
+        void update(size_t now, double seconds);
+    };
+
+    struct Entry
+    {
+        std::weak_ptr<ProgressSlot> slot;
+        Meter meter;
+    };
+
+    std::mutex mtx_; /* guards entries_, the console and the render state */
+    std::condition_variable cv_;
+    std::vector<Entry> entries_;
+    std::thread thread_;
+    bool running_ = false;
+    size_t drawn_ = 0;
+    size_t jobs_ = 0;
+    size_t finished_ = 0;
+    Meter total_;
+    /* received at start(), the summary counts from here */
+    size_t baseReceived_ = 0;
+    std::chrono::steady_clock::time_point lastFrame_;
+
+    void run();
+    void render();
+    void clear();
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+/* A limit that applies during part of the day, minutes since local midnight */
+struct RateWindow
+{
+    int begin = 0;
+    /* exclusive, a window with end <= begin wraps past midnight */
+    int end = 0;
+    /* bytes per second, 0 = unlimited */
+    size_t bytesPerSecond = 0;
+};
+
+/**
+ * Process-wide token bucket shared by every transfer.
+ * Transfers ask for tokens as data arrives and pause themselves (curl_easy_pause)
+ * when the bucket is empty; performGet's poll loop checks ready() every 10 ms and
+ * unpauses them once it refills.
+ * The bucket may go into debt by one chunk, so the long-run rate stays exact. */
+class RateLimiter
+{
+public:
+    static RateLimiter &instance();
+
+    /* limit outside any schedule window, 0 = unlimited, safe to call while downloading */
+    void setLimit(size_t bytesPerSecond);
+    /* the first matching window wins */
+    void setSchedule(const std::vector<RateWindow> &windows);
+
+    /* limit in effect right now */
+    size_t limit();
+    /* takes tokens for a received chunk, false means pause and retry later */
+    bool acquire(size_t bytes);
+    /* true once a paused transfer may continue */
+    bool ready();
+
+private:
+    /* burst allowed after an idle period, in seconds of the current limit */
+    static constexpr double BURST_SECONDS = 0.25;
+
+    std::mutex mtx_;
+    /* fast path while neither a limit nor a schedule is set */
+    std::atomic<bool> enabled_{false};
+    size_t baseLimit_ = 0;
+    std::vector<RateWindow> schedule_;
+    size_t current_ = 0;
+    double tokens_ = 0.0;
+    std::chrono::steady_clock::time_point lastRefill_;
+    std::chrono::steady_clock::time_point nextScheduleCheck_;
+
+    void refill();
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cpr/cpr.h>
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+/* What a finished request means for the next attempt */
+struct RequestResult
+{
+    enum Kind
+    {
+        Success,
+        Transient, /* timeouts, dropped connections, 5xx, 408, 429 */
+        Permanent  /* 4xx and local errors a retry cannot fix */
+    };
+
+    Kind kind = Success;
+    /* delay asked for by the server (Retry-After), zero when absent */
+    std::chrono::milliseconds retryAfter{0};
+    /* HTTP status behind the result, 0 when no response arrived */
+    long status = 0;
+
+    bool ok() const { return kind == Success; }
+};
+
+/**
+ * Delays between attempts of one operation, decorrelated jitter:
+ * each delay is drawn from [base, 3 * previous] and capped, so clients
+ * that failed together do not retry together. Retry-After wins when longer. */
+class Backoff
+{
+public:
+    explicit Backoff(std::chrono::milliseconds base = std::chrono::seconds(1),
+                     std::chrono::milliseconds cap = std::chrono::seconds(30));
+
+    std::chrono::milliseconds next(const RequestResult &result = {RequestResult::Transient});
+
+private:
+    std::chrono::milliseconds base_;
+    std::chrono::milliseconds cap_;
+    std::chrono::milliseconds previous_;
+};
+
+/**
+ * Retry policy shared by every network call: failure classification and a
+ * circuit breaker per host. After repeated transient failures a host is left
+ * alone for a cooldown, then a single probe request decides whether it recovered. */
+class RetryPolicy
+{
+public:
+    static RetryPolicy &instance();
+
+    static RequestResult classify(const cpr::Response &response);
+    /* for transfers that read their headers through a HeaderCallback */
+    static RequestResult classify(long status, const cpr::Error &error, const std::string &retryAfter = "");
+
+    /* false while the host's breaker is open, retryAt is when to ask again */
+    bool allow(const std::string &url, std::chrono::steady_clock::time_point *retryAt = nullptr);
+    void record(const std::string &url, const RequestResult &result);
+
+    /* send until success, a permanent failure or the last attempt, waiting out backoff and breaker */
+    cpr::Response perform(const std::string &url, const std::function<cpr::Response()> &send, int attempts = 3);
+
+private:
+    /* consecutive transient failures that open a host's breaker */
+    static const int FAILURE_THRESHOLD = 5;
+    static constexpr std::chrono::seconds BASE_COOLDOWN{10};
+    static constexpr std::chrono::seconds MAX_COOLDOWN{120};
+
+    struct Breaker
+    {
+        enum State { Closed, Open, HalfOpen } state = Closed;
+        int failures = 0;
+        std::chrono::seconds cooldown = BASE_COOLDOWN;
+        std::chrono::steady_clock::time_point openUntil;
+        /* half-open: a probe request is in flight */
+        bool probing = false;
+    };
+
+    std::mutex mtx_;
+    std::map<std::string, Breaker> breakers_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cpr/cpr.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/* How a pooled session is used, sessions are only reused within the same kind */
+enum class SessionKind
+{
+    Browse, /* GET with the shared cookie jar (animepahe pages and API) */
+    Plain,  /* GET with a fresh cookie jar per request, for callers that read Set-Cookie themselves */
+    Form    /* POST, fresh cookie jar per request */
+};
+
+/**
+ * Process-wide pool of cpr sessions keyed by host.
+ * Every session handed out is attached to a curl share handle, so DNS lookups and
+ * TLS sessions are reused across requests and threads; Browse sessions also share
+ * one cookie jar. Keep-alive connections stay with their easy handle, and come
+ * back with it when the session is returned to the pool.
+ * acquire() resets a reused session's per-request options, headers, request cookies,
+ * redirects, payload and write callback, so nothing carries over but the connection. */
+class SessionPool
+{
+public:
+    /* Session checked out for one request, goes back to the pool when destroyed */
+    class Lease
+    {
+    public:
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&) = delete;
+        Lease(const Lease &) = delete;
+        ~Lease();
+
+        cpr::Session &operator*() { return *session_; }
+        cpr::Session *operator->() { return session_.get(); }
+
+    private:
+        friend class SessionPool;
+        Lease(SessionPool *pool, std::string key, std::unique_ptr<cpr::Session> session);
+
+        SessionPool *pool_;
+        std::string key_;
+        std::unique_ptr<cpr::Session> session_;
+    };
+
+    static SessionPool &instance();
+    ~SessionPool();
+
+    Lease acquire(const std::string &url, SessionKind kind = SessionKind::Plain);
+    /* share DNS and TLS sessions with a session the caller keeps, e.g. a download */
+    void attach(cpr::Session &session);
+
+private:
+    /* idle sessions kept per host and kind */
+    static const size_t MAX_IDLE = 8;
+
+    struct Share;
+    std::unique_ptr<Share> shared_;
+    std::unique_ptr<Share> browse_;
+    std::mutex mtx_;
+    std::map<std::string, std::vector<std::unique_ptr<cpr::Session>>> idle_;
+
+    SessionPool();
+    void release(const std::string &key, std::unique_ptr<cpr::Session> session);
+};
+
+/* scheme://host[:port], the part of a url a connection can be reused for */
+std::string originOf(const std::string &url);
+
+/* send request cookies without touching the session's cookie jar */
+void setRequestCookies(cpr::Session &session, const cpr::Cookies &cookies);
@@ -8,19 +8,30 @@
 #include <map>
 #include <sstream>
 
+struct RateWindow;
+
 namespace AnimepaheCLI
 {
     std::string replaceSpacesWithUnderscore(std::string text);
     std::string sanitizeForWindowsPath(std::string name);
-    int getPage(int number);
+    /* release API page holding episode number, perPage as reported by the API */
+    int getPage(int number, int perPage = 30);
     bool isValidTxtFilename(const std::string& filename);
-    std::vector<int> getPaginationRange(int start, int end);
-    std::string sanitize_utf8(const std::string &input);
+    std::vector<int> getPaginationRange(int start, int end, int perPage = 30);
+    /**
+     * Drops every byte that does not start or continue a complete UTF-8
+     * sequence. Valid text is handed back as it came in, without a copy,
+     * and invalid text is compacted in place; pass an rvalue to benefit. */
+    std::string sanitize_utf8(std::string input);
     bool isFullSeriesURL(const std::string &url);
     bool isEpisodeURL(const std::string &url);
     bool isValidEpisodeRangeFormat(const std::string &input);
     std::vector<int> parseEpisodeRange(const std::string &input);
-    std::string unescape_html_entities(const std::string &input);
+    bool isValidConnectionsFormat(const std::string &input);
+    bool isValidRateFormat(const std::string &input);
+    size_t parseRate(const std::string &input);
+    bool isValidRateScheduleFormat(const std::string &input);
+    std::vector<RateWindow> parseRateSchedule(const std::string &input);
     std::string padIntWithZero(int num);
     
     template <typename T>
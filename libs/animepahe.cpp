@@ -1,17 +1,28 @@
 #include <animepahe.hpp>
 #include <kwikpahe.hpp>
 #include <downloader.hpp>
+#include <sessionpool.hpp>
+#include <retrypolicy.hpp>
+#include <manifest.hpp>
+#include <httpcache.hpp>
+#include <linkcache.hpp>
+#include <patterns.hpp>
+#include <parsers.hpp>
+#include <htmlentities.hpp>
 #include <cpr/cpr.h>
 #include <re2/re2.h>
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <utils.hpp>
-#include <nlohmann/json.hpp>
 #include <fstream>
 #include <ziputils.hpp>
 #include <iostream>
-
-using json = nlohmann::json;
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include <boundedqueue.hpp>
 
 namespace AnimepaheCLI
 {
@@ -20,8 +31,12 @@ namespace AnimepaheCLI
     const char *MOVE_UP = "\033[1A";    // Move cursor up 1 line
     const char *CURSOR_START = "\r";    // Return to start of line
 
-    /* Extract Kwik from pahe.win */
-    KwikPahe kwikpahe;
+    void Animepahe::setOptions(const ExtractOptions &options)
+    {
+        options_ = options;
+        HttpCache::instance().setEnabled(options_.useCache);
+        LinkCache::instance().setEnabled(options_.useCache);
+    }
 
     cpr::Header Animepahe::getHeaders(const std::string &link)
     {
@@ -33,12 +48,33 @@ namespace AnimepaheCLI
         return HEADERS;
     }
 
+    SessionPool::Lease Animepahe::openSession(const std::string &url, const std::string &link, const cpr::Header &conditional)
+    {
+        cpr::Header headers = getHeaders(link);
+        headers.insert(conditional.begin(), conditional.end());
+
+        auto session = SessionPool::instance().acquire(url, SessionKind::Browse);
+        session->SetUrl(cpr::Url{url});
+        session->SetHeader(headers);
+        setRequestCookies(*session, cookies);
+        return session;
+    }
+
+    cpr::Response Animepahe::request(const std::string &url, const std::string &link, std::chrono::seconds ttl)
+    {
+        return HttpCache::instance().get(url, ttl, [&](const cpr::Header &conditional)
+        {
+            return RetryPolicy::instance().perform(url, [&]()
+            {
+                return openSession(url, link, conditional)->Get();
+            });
+        });
+    }
+
     std::string Animepahe::extract_link_metadata(const std::string &link, bool isSeries)
     {
         fmt::print("\n\r * Requesting Info..");
-        cpr::Response response = cpr::Get(
-            cpr::Url{link},
-            cpr::Header{getHeaders(link)}, cookies);
+        cpr::Response response = request(link, link, isSeries ? SERIES_PAGE_TTL : PLAY_PAGE_TTL);
 
         fmt::print("\r * Requesting Info : ");
 
@@ -55,7 +91,7 @@ namespace AnimepaheCLI
             fmt::print(fmt::fg(fmt::color::lime_green), "OK!\n");
         }
 
-        RE2::GlobalReplace(&response.text, R"((\r\n|\r|\n))", "");
+        RE2::GlobalReplace(&response.text, Patterns::get().newline, "");
 
         if (isSeries)
         {
@@ -66,20 +102,20 @@ namespace AnimepaheCLI
             std::string type;
             std::string episodesCount;
 
-            if (RE2::FindAndConsume(&TITLE_CONSUME, R"re(style=[^=]+title="([^"]+)")re", &title))
+            if (RE2::FindAndConsume(&TITLE_CONSUME, Patterns::get().seriesTitle, &title))
             {
-                title = unescape_html_entities(title);
+                decodeHtmlEntities(title);
                 series_title = title;
             }
 
-            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Type:[^>]*title="[^"]*"[^>]*>([^<]+)</a>)re", &type))
+            if (RE2::FindAndConsume(&TYPE_CONSUME, Patterns::get().seriesType, &type))
             {
-                type = unescape_html_entities(type);
+                decodeHtmlEntities(type);
             }
 
-            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Episode[^>]*>\s*(\S*)</p)re", &episodesCount))
+            if (RE2::FindAndConsume(&TYPE_CONSUME, Patterns::get().seriesEpisodes, &episodesCount))
             {
-                episodesCount = unescape_html_entities(episodesCount);
+                decodeHtmlEntities(episodesCount);
             }
 
             fmt::print("\n * Anime: {}\n", title);
@@ -92,10 +128,10 @@ namespace AnimepaheCLI
             std::string title;
             std::string episode;
 
-            if (RE2::FindAndConsume(&TITLE_TYPE_CONSUME, R"re(title="[^>]*>([^<]*)</a>\D*(\d*)<span)re", &title, &episode))
+            if (RE2::FindAndConsume(&TITLE_TYPE_CONSUME, Patterns::get().episodeTitle, &title, &episode))
             {
-                episode = unescape_html_entities(episode);
-                title = unescape_html_entities(title);
+                decodeHtmlEntities(episode);
+                decodeHtmlEntities(title);
                 series_title = title;
             }
 
@@ -106,315 +142,422 @@ namespace AnimepaheCLI
         return series_title;
     }
 
-    std::map<std::string, std::string> Animepahe::fetch_episode(const std::string &link, const int &targetRes, const std::string &audioLang)
+    EpisodeSource Animepahe::fetch_episode(const std::string &link, const int targetRes, const AudioLang audioLang)
     {
-        std::vector<std::map<std::string, std::string>> episodeData;
-        cpr::Response response = cpr::Get(
-            cpr::Url{link},
-            cpr::Header{getHeaders(link)}, cookies);
-
-        if (response.status_code != 200)
+        if (link.empty())
         {
-            fmt::print("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code);
-            return {};
+            throw std::runtime_error("its release page could not be read");
         }
 
-        RE2::GlobalReplace(&response.text, R"((\r\n|\r|\n))", "");
-        re2::StringPiece EP_CONSUME = response.text;
-        std::string dPaheLink;
-        std::string epBlock;
-
-        while (RE2::FindAndConsume(&EP_CONSUME, R"re(<a href="(https://pahe\.win/\S*)"[^>]*>(.*?)</a>)re", &dPaheLink, &epBlock))
+        /**
+         * The page is scanned while it downloads and the transfer stops after the
+         * download menu. Only the menu is cached, under its own key: the fragment
+         * never reaches the server but keeps the entry apart from the whole page. */
+        PlayPageScanner scanner;
+        bool scanned = false;
+        cpr::Response response = HttpCache::instance().get(link + "#pickDownload", PLAY_PAGE_TTL, [&](const cpr::Header &conditional)
         {
-            std::map<std::string, std::string> content;
-            content["dPaheLink"] = unescape_html_entities(dPaheLink);
-            re2::StringPiece epPiece(epBlock);
-            std::string sourceText;
-            RE2::PartialMatch(epPiece, R"re(\s*([^<]*))re", &sourceText);
-            sourceText.erase(sourceText.find_last_not_of(" \t\n\r") + 1);
-            content["sourceText"] = unescape_html_entities(sourceText);
-
-            epPiece = re2::StringPiece(epBlock);
-            std::string epRes;
-            if (RE2::FindAndConsume(&epPiece, R"re(\b(\d{3,4})p\b)re", &epRes))
+            cpr::Response fetched = RetryPolicy::instance().perform(link, [&]()
             {
-                epRes = unescape_html_entities(epRes);
-            }
-            else
-            {
-                epRes = "0"; // default
-            }
-            content["epRes"] = epRes;
-            
-            content["epLang"] = "jp"; // default if not changed later.
-
-            // Check for a span containing the language.
-            epPiece = re2::StringPiece(epBlock);
-            std::string spanContent;
-            while (RE2::FindAndConsume(&epPiece, R"re(<span[^>]*>([^<]*)</span>)re", &spanContent)) {
-                std::transform(spanContent.begin(), spanContent.end(), spanContent.begin(), ::tolower);
-                if (spanContent == "bd")
-                {
-                    // Do nothing so far with the Blu-ray disk tag.
-                }
-                else if (spanContent == "dub")
-                {
-                    content["epLang"] = "eng";
-                    break;
-                }
-                else if (spanContent == "chi")
+                scanner = PlayPageScanner();
+                auto session = openSession(link, link, conditional);
+                session->SetWriteCallback(cpr::WriteCallback{[&scanner](std::string data, intptr_t)
                 {
-                    content["epLang"] = "zh";
-                    break;
-                }
-                else
+                    return scanner.feed(data);
+                }});
+                /* the pool drops this callback before the session is handed out again, even if Get throws */
+                cpr::Response attempt = session->Get();
+
+                if (scanner.done())
                 {
-                    content["epLang"] = spanContent; // treat remaining spans as a language.
-                    break;
+                    /* stopping the transfer is not a failure */
+                    attempt.error = cpr::Error{};
                 }
+                attempt.text = scanner.section();
+                return attempt;
+            });
+            scanned = fetched.status_code == 200;
+            if (scanned && !scanner.complete())
+            {
+                /* no menu yet (links not up, or a challenge page): answer this call but keep it out of the cache */
+                fetched.error.code = cpr::ErrorCode::UNKNOWN_ERROR;
+                fetched.error.message = "download menu not found";
             }
+            return fetched;
+        });
 
-            episodeData.push_back(content);
+        if (response.status_code != 200)
+        {
+            throw std::runtime_error(fmt::format("Failed to fetch {}, StatusCode {}", link, response.status_code));
         }
 
-        if (episodeData.empty())
+        /* a cached or revalidated menu has not been through the scanner */
+        std::vector<EpisodeSource> sources = scanned ? scanner.sources() : parsePlayPage(response.text);
+        const EpisodeSource *selected = SourceIndex(sources).select(audioLang, targetRes);
+        if (!selected)
         {
-            throw std::runtime_error(fmt::format("\n No episodes found in {}", link));
+            throw std::runtime_error(fmt::format("No episodes found in {}", link));
         }
+        return *selected;
+    }
 
-        /**
-         * Filter episodes by language preference
-         * AnimePahe sorts JPN episodes at top, followed by ENG
-         * We filter by checking if episode name contains language indicators
-         */
-        std::vector<std::map<std::string, std::string>> filteredData;
-        for (const auto& episode : episodeData)
-        {
-            const std::string& epLang = episode.at("epLang");
-
-            if (
-                (audioLang == "en" && epLang == "eng") ||
-                (audioLang == "jp" && epLang == "jp")  ||
-                (audioLang == "zh" && epLang == "zh")
-            ) {
-                filteredData.push_back(episode);
-            }
+    /* play page links in one parsed release API page */
+    static std::vector<std::string> releaseLinks(const ReleasePage &page, const std::string &id)
+    {
+        std::vector<std::string> links;
+        links.reserve(page.sessions.size());
+        for (const std::string &session : page.sessions)
+        {
+            links.push_back(fmt::format("https://animepahe.si/play/{}/{}", id, session.empty() ? "unknown" : session));
         }
+        return links;
+    }
+
+    std::vector<std::string> Animepahe::fetch_release_page(const std::string &link, const std::string &id, int page, std::chrono::seconds ttl)
+    {
+        cpr::Response response = request(
+            fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, page), link, ttl);
 
-        // Fallback to all episodes if no matches found for requested language
-        if (filteredData.empty())
+        if (response.status_code != 200)
         {
-            filteredData = episodeData;
+            throw std::runtime_error(fmt::format("Release page {} failed, StatusCode {}", page, response.status_code));
         }
 
-        /**
-         * check if there is a provided resolution
-         * if there is a match then return it otherwise Find the episode with the highest resolution
-         */
-        std::map<std::string, std::string>* selectedEpMap = nullptr;
-        std::map<std::string, std::string>* maxEpMap = nullptr;
-        std::map<std::string, std::string>* minEpMap = nullptr;
+        ReleasePage parsed;
+        if (!parseReleasePage(response.text, parsed))
+        {
+            throw std::runtime_error(fmt::format("Release page {} is malformed", page));
+        }
+        return releaseLinks(parsed, id);
+    }
 
-        int maxEpRes = 0;
-        int minEpRes = INT_MAX; /* use INT_MAX to ensure proper min comparison */
+    ReleaseInfo Animepahe::fetch_release_info(const std::string &link)
+    {
+        ReleaseInfo info;
+        RE2::PartialMatch(link, Patterns::get().seriesId, &info.id);
 
-        bool selectHighestQuality = (targetRes == 0);
-        bool selectLowestQuality  = (targetRes == -1);
-        bool isCustomQualityProvided = (targetRes > 0); /* only valid custom inputs are > 0 */
+        /* always revalidated, it carries the episode count */
+        cpr::Response response = request(
+            fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", info.id, 1), link);
 
-        for (auto& episode : filteredData)
+        if (response.status_code != 200)
         {
-            int epResValue = std::stoi(episode.at("epRes"));
-
-            /* Track highest */
-            if (epResValue > maxEpRes)
-            {
-                maxEpRes = epResValue;
-                maxEpMap = &episode;
-            }
-
-            /* Track lowest */
-            if (epResValue < minEpRes)
-            {
-                minEpRes = epResValue;
-                minEpMap = &episode;
-            }
+            throw std::runtime_error(fmt::format("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code));
+        }
 
-            /* If custom quality requested */
-            if (isCustomQualityProvided && epResValue == targetRes)
-            {
-                selectedEpMap = &episode;
-                break; /* exact match found, no need to continue */
-            }
+        ReleasePage parsed;
+        const bool complete = parseReleasePage(response.text, parsed);
+        if (!complete && parsed.total == 0)
+        {
+            throw std::runtime_error(fmt::format("\n * Error: Unreadable release data for {}\n", link));
         }
 
-        /* Final decision */
-        if (selectedEpMap == nullptr)
+        info.total = parsed.total;
+        if (parsed.perPage > 0)
         {
-            if (selectHighestQuality) {
-                selectedEpMap = maxEpMap;
-            } else if (selectLowestQuality) {
-                selectedEpMap = minEpMap;
-            }
-            /* else (custom and not found) fallback to max */
-            else {
-                selectedEpMap = maxEpMap;
-            }
+            info.perPage = parsed.perPage;
+        }
+        info.lastPage = parsed.lastPage > 0 ? parsed.lastPage : getPage(info.total, info.perPage);
+        /* a page cut short is left empty, fetch_series then reports its episodes as failed */
+        if (complete)
+        {
+            info.firstPage = releaseLinks(parsed, info.id);
         }
 
-        return *selectedEpMap;
+        return info;
     }
 
     std::vector<std::string> Animepahe::fetch_series(
         const std::string &link,
-        const int epCount,
+        const ReleaseInfo &info,
         bool isAllEpisodes,
         const std::vector<int> &episodes)
     {
-        std::vector<std::string> links;
         std::vector<int> paginationPages;
 
         if (isAllEpisodes)
         {
-            paginationPages = getPaginationRange(1, epCount);
+            paginationPages = getPaginationRange(1, info.total, info.perPage);
         }
         else
         {
-            paginationPages = getPaginationRange(episodes[0], episodes[1]);
+            paginationPages = getPaginationRange(episodes[0], episodes[1], info.perPage);
         }
-
-        std::string id;
-        RE2::PartialMatch(link, R"(anime/([a-f0-9-]{36}))", &id);
-        fmt::print("\n\r * Requesting Pages..");
-        for (auto &page : paginationPages)
+        /* never ask for pages past the end the API reported */
+        while (paginationPages.size() > 1 && paginationPages.back() > info.lastPage)
         {
-            fmt::print("\r * Requesting Pages : {}", page);
-            fflush(stdout);
-            cpr::Response response = cpr::Get(
-                cpr::Url{
-                    fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, page)},
-                cpr::Header{getHeaders(link)}, cookies);
+            paginationPages.pop_back();
+        }
 
-            if (response.status_code != 200)
+        /**
+         * Page 1 was already read by fetch_release_info, every other page is
+         * independent of the rest so they are requested together and joined in order. */
+        std::vector<std::vector<std::string>> pageLinks(paginationPages.size());
+        std::vector<std::exception_ptr> errors(paginationPages.size());
+        std::atomic<size_t> next{0};
+        std::mutex mtx; /* guards the progress line */
+        size_t completed = 0;
+
+        fmt::print("\n\r * Requesting Pages : 0/{}", paginationPages.size());
+        fflush(stdout);
+
+        auto worker = [&]()
+        {
+            for (size_t idx = next++; idx < paginationPages.size(); idx = next++)
             {
-                throw std::runtime_error(fmt::format("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code));
+                try
+                {
+                    /* pages before the last are full and only change if the series is re-sorted */
+                    const int page = paginationPages[idx];
+                    if (page == 1 && info.firstPage.empty() && info.total > 0)
+                    {
+                        throw std::runtime_error("Release page 1 is malformed");
+                    }
+                    pageLinks[idx] = page == 1 ? info.firstPage
+                                               : fetch_release_page(link, info.id, page, page < info.lastPage ? FULL_RELEASE_PAGE_TTL : std::chrono::seconds(0));
+                }
+                catch (...)
+                {
+                    errors[idx] = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mtx);
+                completed++;
+                fmt::print("\r * Requesting Pages : {}/{}", completed, paginationPages.size());
+                fflush(stdout);
             }
+        };
 
-            auto parsed = json::parse(response.text);
+        std::vector<std::thread> workers;
+        size_t workerCount = std::min<size_t>(std::max(1, options_.pageWorkers), paginationPages.size());
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto &t : workers)
+        {
+            t.join();
+        }
 
-            if (parsed.contains("data") && parsed["data"].is_array())
+        std::vector<std::string> links;
+        std::vector<std::string> failures;
+        for (size_t idx = 0; idx < paginationPages.size(); ++idx)
+        {
+            if (errors[idx])
             {
-                for (const auto &episode : parsed["data"])
+                /**
+                 * One unreadable page costs only its own episodes: empty links keep
+                 * the positions of the pages after it, the resolver reports them. */
+                const int page = paginationPages[idx];
+                const int listed = page < info.lastPage ? info.perPage : info.total - (page - 1) * info.perPage;
+                links.insert(links.end(), std::max(0, listed), std::string());
+                try
                 {
-                    std::string session = episode.value("session", "unknown");
-                    std::string episodeLink = fmt::format("https://animepahe.si/play/{}/{}", id, session);
-                    links.push_back(episodeLink);
+                    std::rethrow_exception(errors[idx]);
                 }
+                catch (const std::exception &e)
+                {
+                    failures.push_back(e.what());
+                }
+                continue;
             }
+            links.insert(links.end(), pageLinks[idx].begin(), pageLinks[idx].end());
         }
-        fmt::print("\r * Requesting Pages :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n\r");
-
-        return links;
-    }
-
-    int Animepahe::get_series_episode_count(const std::string &link)
-    {
-        std::string id;
-        RE2::PartialMatch(link, R"(anime/([a-f0-9-]{36}))", &id);
-
-        cpr::Response response = cpr::Get(
-            cpr::Url{
-                fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, 1)},
-            cpr::Header{getHeaders(link)}, cookies);
-
-        if (response.status_code != 200)
+        fmt::print("\r * Requesting Pages : {}/{}", paginationPages.size() - failures.size(), paginationPages.size());
+        if (failures.empty())
         {
-            throw std::runtime_error(fmt::format("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code));
+            fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n\r");
         }
-
-        auto parsed = json::parse(response.text);
-        int epCount = 0;
-        if (parsed.contains("total") && parsed["total"].is_number_integer())
+        else
         {
-            epCount = parsed["total"];
+            fmt::print(fmt::fg(fmt::color::indian_red), " {} FAILED!\n\r", failures.size());
+            for (const std::string &failure : failures)
+            {
+                fmt::print(" * {}\n", failure);
+            }
         }
 
-        return epCount;
+        return links;
     }
 
-    std::vector<std::map<std::string, std::string>> Animepahe::extract_link_content(
+    std::vector<std::pair<int, std::string>> Animepahe::list_episode_pages(
         const std::string &link,
         const std::vector<int> &episodes,
-        const int targetRes,
-        const std::string &audioLang,
         bool isSeries,
         bool isAllEpisodes)
     {
-        std::vector<std::map<std::string, std::string>> episodeListData;
+        /* episode number and play page of every episode to fetch */
+        std::vector<std::pair<int, std::string>> pages;
 
         if (isSeries)
         {
-            const int epCount = get_series_episode_count(link);
-            std::vector<std::string> seriesEpLinks = fetch_series(link, epCount, isAllEpisodes, episodes);
+            const ReleaseInfo info = fetch_release_info(link);
+            const int epCount = info.total;
+            if (!isAllEpisodes && (episodes[0] > epCount || episodes[1] > epCount))
+            {
+                throw std::runtime_error(fmt::format("Invalid episode range: {}-{} for series with {} episodes", episodes[0], episodes[1], epCount));
+            }
+            std::vector<std::string> seriesEpLinks = fetch_series(link, info, isAllEpisodes, episodes);
 
             if (isAllEpisodes)
             {
                 for (int i = 0; i < seriesEpLinks.size(); ++i)
                 {
-                    const std::string &pLink = seriesEpLinks[i];
-                    fmt::print("\r * Requesting Episode : EP{} ", padIntWithZero(i + 1));
-                    std::map<std::string, std::string> epContent = fetch_episode(pLink, targetRes, audioLang);
-                    fflush(stdout);
-                    if (!epContent.empty())
-                    {
-                        episodeListData.push_back(epContent);
-                    }
+                    pages.emplace_back(i + 1, seriesEpLinks[i]);
                 }
             }
             else
             {
-                if (episodes[0] > epCount || episodes[1] > epCount)
-                {
-                    throw std::runtime_error(fmt::format("Invalid episode range: {}-{} for series with {} episodes", episodes[0], episodes[1], epCount));
-                }
-
-                std::vector<int> paginationPages = getPaginationRange(episodes[0], episodes[1]);
-                int offset = paginationPages[0] == 1 ? 0 : (30 * (paginationPages[0] - 1));
+                int offset = info.perPage * (getPage(episodes[0], info.perPage) - 1);
 
                 for (int i = offset; i < (seriesEpLinks.size() + offset); ++i)
                 {
-                    const std::string &pLink = seriesEpLinks[i - offset];
-
                     if ((i >= episodes[0] - 1 && i <= episodes[1] - 1))
                     {
-                        fmt::print("\r * Requesting Episode : EP{} ", padIntWithZero(i + 1));
-                        std::map<std::string, std::string> epContent = fetch_episode(pLink, targetRes, audioLang);
-                        fflush(stdout);
-                        if (!epContent.empty())
-                        {
-                            episodeListData.push_back(epContent);
-                        }
+                        pages.emplace_back(i + 1, seriesEpLinks[i - offset]);
                     }
                 }
             }
         }
         else
         {
+            pages.emplace_back(episodes.empty() ? 1 : episodes[0], link);
+        }
+
+        return pages;
+    }
+
+    std::string Animepahe::resolve_direct_link(const std::string &source, bool *cached)
+    {
+        std::string link = LinkCache::instance().lookup(source);
+        if (cached)
+        {
+            *cached = !link.empty();
+        }
+        if (link.empty())
+        {
+            /* KwikPahe keeps no state, a local one per call is free */
+            link = KwikPahe().extract_kwik_link(source);
+            LinkCache::instance().store(source, link);
+        }
+        return link;
+    }
+
+    /* what an episode was downloaded for, e.g. "1080/jp"; 0 and -1 stand for highest and lowest */
+    static std::string requestVariant(int targetRes, const std::string &audioLang)
+    {
+        return fmt::format("{}/{}", targetRes, audioLang);
+    }
+
+    std::vector<ResolvedEpisode> Animepahe::resolve_episodes(
+        const std::vector<std::pair<int, std::string>> &pages,
+        const int targetRes,
+        const std::string &audioLang,
+        const Manifest *finished,
+        const std::function<void(const std::string &)> &log,
+        const std::function<void(const ResolvedEpisode &)> &sink)
+    {
+        /**
+         * Two stages joined by a bounded queue: page workers fetch play pages and
+         * pick the stream, resolvers turn each into a kwik direct link and hand
+         * it to sink() right away, so downloads start after the first episode
+         * instead of after the last. Results are also kept in episode order. */
+        struct PlayItem
+        {
+            size_t index;
+            EpisodeSource source;
+        };
+
+        std::vector<ResolvedEpisode> results(pages.size());
+        const AudioLang lang = parseAudioLang(audioLang);
+        const std::string variant = requestVariant(targetRes, audioLang);
+        const int resolveWorkerCount = std::max(1, options_.resolveWorkers);
+        BoundedQueue<PlayItem> resolveQueue(std::max<size_t>(PIPELINE_DEPTH, 2 * resolveWorkerCount));
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> pageWorkersLeft{0};
+        std::mutex logMtx; /* keeps lines from different stages whole */
+
+        auto report = [&](size_t idx, const std::string &status, const std::string &detail)
+        {
+            std::lock_guard<std::mutex> lock(logMtx);
+            log(fmt::format(" * Processing : EP{} {}{}", padIntWithZero(pages[idx].first), status, detail.empty() ? "" : " " + detail));
+        };
+
+        auto pageWorker = [&]()
+        {
+            for (size_t idx = next++; idx < pages.size(); idx = next++)
+            {
+                /* finished by an earlier run asking for the same stream: no play page, no Kwik */
+                if (finished && finished->containsPage(pages[idx].second, variant))
+                {
+                    report(idx, fmt::format(fmt::fg(fmt::color::cyan), "SKIP!"), "");
+                    continue;
+                }
+
+                try
+                {
+                    resolveQueue.push(PlayItem{idx, fetch_episode(pages[idx].second, targetRes, lang)});
+                }
+                catch (const std::exception &e)
+                {
+                    report(idx, fmt::format(fmt::fg(fmt::color::indian_red), "FAIL!"), e.what());
+                }
+            }
+            /* the last page worker out tells the resolver nothing more is coming */
+            if (--pageWorkersLeft == 0)
+            {
+                resolveQueue.close();
+            }
+        };
 
-            std::map<std::string, std::string> epContent = fetch_episode(link, targetRes, audioLang);
-            if (epContent.empty())
+        auto resolveWorker = [&]()
+        {
+            PlayItem item;
+            while (resolveQueue.pop(item))
             {
-                fmt::print("\n * Error: No episode data found for {}\n", link);
-                return {};
+                const std::string &source = item.source.link;
+                if (finished && finished->containsSource(source))
+                {
+                    report(item.index, fmt::format(fmt::fg(fmt::color::cyan), "SKIP!"), "");
+                    continue;
+                }
+
+                try
+                {
+                    bool cached = false;
+                    ResolvedEpisode episode{pages[item.index].first, pages[item.index].second, variant, source, resolve_direct_link(source, &cached)};
+                    report(item.index, fmt::format(fmt::fg(fmt::color::lime_green), "OK!"), cached ? "(cached link)" : "");
+                    results[item.index] = episode;
+                    sink(episode);
+                }
+                catch (const std::exception &e)
+                {
+                    report(item.index, fmt::format(fmt::fg(fmt::color::indian_red), "FAIL!"), e.what());
+                }
             }
+        };
 
-            episodeListData.push_back(epContent);
+        size_t pageWorkerCount = std::min<size_t>(std::max(1, options_.pageWorkers), std::max<size_t>(1, pages.size()));
+        pageWorkersLeft = pageWorkerCount;
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < pageWorkerCount; ++i)
+        {
+            workers.emplace_back(pageWorker);
+        }
+        for (int i = 0; i < resolveWorkerCount; ++i)
+        {
+            workers.emplace_back(resolveWorker);
+        }
+        for (auto &t : workers)
+        {
+            t.join();
         }
 
-        fmt::print("\r * Requesting Episodes : {} ", episodeListData.size());
-        fmt::print(fmt::fg(fmt::color::lime_green), "OK!\n");
-        return episodeListData;
+        results.erase(std::remove_if(results.begin(), results.end(), [](const ResolvedEpisode &episode)
+        {
+            return episode.directLink.empty();
+        }), results.end());
+        return results;
     }
 
     void Animepahe::extractor(
@@ -427,7 +570,8 @@ namespace AnimepaheCLI
         const std::string &export_filename,
         bool exportLinks,
         bool createZip,
-        bool removeSource
+        bool removeSource,
+        const DownloadOptions &downloadOptions
     )
     {
         /* print config */
@@ -449,6 +593,34 @@ namespace AnimepaheCLI
         fmt::print(" * exportLinks: ");
         exportLinks ? fmt::print(fmt::fg(fmt::color::cyan), "true") : fmt::print("false");
         (exportLinks && export_filename != "links.txt") ? fmt::print(fmt::fg(fmt::color::cyan), fmt::format(" [{}]\n", export_filename)) : fmt::print("\n");
+        fmt::print(" * pageWorkers: ");
+        options_.pageWorkers == ExtractOptions{}.pageWorkers ? fmt::print("{}\n", options_.pageWorkers) : fmt::print(fmt::fg(fmt::color::cyan), "{}\n", options_.pageWorkers);
+        fmt::print(" * resolveWorkers: ");
+        options_.resolveWorkers == ExtractOptions{}.resolveWorkers ? fmt::print("{}\n", options_.resolveWorkers) : fmt::print(fmt::fg(fmt::color::cyan), "{}\n", options_.resolveWorkers);
+        if (!options_.useCache)
+        {
+            fmt::print(" * cache: ");
+            fmt::print(fmt::fg(fmt::color::cyan), "off\n");
+        }
+        fmt::print(" * connections: ");
+        downloadOptions.connections == 1 ? fmt::print("1\n") : fmt::print(fmt::fg(fmt::color::cyan), downloadOptions.connections == 0 ? "auto\n" : fmt::format("{}\n", downloadOptions.connections));
+        fmt::print(" * parallelDownloads: ");
+        downloadOptions.parallelDownloads == 1 ? fmt::print("1\n") : fmt::print(fmt::fg(fmt::color::cyan), fmt::format("{}\n", downloadOptions.parallelDownloads));
+        if (downloadOptions.order == DownloadOrder::LargestFirst)
+        {
+            fmt::print(" * downloadOrder: ");
+            fmt::print(fmt::fg(fmt::color::cyan), "Largest First\n");
+        }
+        if (downloadOptions.rateLimit > 0)
+        {
+            fmt::print(" * rateLimit: ");
+            fmt::print(fmt::fg(fmt::color::cyan), "{:.2f} MB/s\n", downloadOptions.rateLimit / (1024.0 * 1024.0));
+        }
+        if (!downloadOptions.rateSchedule.empty())
+        {
+            fmt::print(" * rateSchedule: ");
+            fmt::print(fmt::fg(fmt::color::cyan), "{} windows\n", downloadOptions.rateSchedule.size());
+        }
         fmt::print(" * createZip: ", createZip);
         createZip ? fmt::print(fmt::fg(fmt::color::cyan), "true") : fmt::print("false\n");
         if (createZip && removeSource)
@@ -470,41 +642,30 @@ namespace AnimepaheCLI
         /* Request Metadata */
         std::string series_name = extract_link_metadata(link, isSeries);
 
-        /* Extract Links */
-        const std::vector<std::map<std::string, std::string>> epData = extract_link_content(link, episodes, targetRes, audioLang, isSeries, isAllEpisodes);
+        /* sanitize anime name for windows support */
+        std::string dirName = sanitizeForWindowsPath(series_name);
+        /* episodes finished by an earlier run into the same directory */
+        Manifest manifest(dirName);
 
-        std::vector<std::string> directLinks;
-        int logEpNum = isAllEpisodes ? 1 : episodes[0];
-        for (int i = 0; i < epData.size(); ++i)
+        const std::vector<std::pair<int, std::string>> pages = list_episode_pages(link, episodes, isSeries, isAllEpisodes);
+
+        auto print = [](const std::string &message)
         {
-            fmt::print("\n\r * Processing :");
-            fmt::print(fmt::fg(fmt::color::cyan), fmt::format(" EP{}", padIntWithZero(logEpNum)));
-            std::string link = kwikpahe.extract_kwik_link(epData[i].at("dPaheLink"));
-            for (int i = 0; i < 3; ++i)
-            {
-                fmt::print("{}{}{}", MOVE_UP, CLEAR_LINE, CURSOR_START);
-            }
-            fmt::print("\r * Processing : EP{}", padIntWithZero(logEpNum));
-            if (link.empty())
-            {
-                fmt::print(fmt::fg(fmt::color::indian_red), " FAIL!");
-            }
-            else
-            {
-                directLinks.push_back(link);
-                fmt::print(fmt::fg(fmt::color::lime_green), " OK!");
-            }
-            logEpNum++;
-        }
+            fmt::print("\n{}", message);
+            fflush(stdout);
+        };
+        auto ignore = [](const ResolvedEpisode &) {};
 
         if (exportLinks)
         {
+            const std::vector<ResolvedEpisode> resolved = resolve_episodes(pages, targetRes, audioLang, nullptr, print, ignore);
+
             std::ofstream exportfile(export_filename);
             if (exportfile.is_open())
             {
-                for (auto &link : directLinks)
+                for (auto &episode : resolved)
                 {
-                    exportfile << link << "\n";
+                    exportfile << episode.directLink << "\n";
                 }
                 exportfile.close();
             }
@@ -512,11 +673,51 @@ namespace AnimepaheCLI
         }
         else
         {
-            /* sanitize anime name for windows support */
-            std::string dirName = sanitizeForWindowsPath(series_name);
-            Downloader downloader(directLinks);
-            downloader.setDownloadDirectory(dirName);
-            downloader.startDownloads();
+            /* a download refused with 403/410 drops the cached link and resolves the episode again */
+            auto relink = [this](const std::string &source)
+            {
+                LinkCache::instance().reject(source);
+                return resolve_direct_link(source);
+            };
+
+            if (downloadOptions.order == DownloadOrder::LargestFirst)
+            {
+                /* largest first needs every size before the first transfer, resolve everything up front */
+                std::vector<std::string> directLinks;
+                std::vector<DownloadOrigin> sources;
+                for (const auto &episode : resolve_episodes(pages, targetRes, audioLang, &manifest, print, ignore))
+                {
+                    directLinks.push_back(episode.directLink);
+                    sources.push_back(DownloadOrigin{episode.source, episode.page, episode.variant});
+                }
+
+                Downloader downloader(directLinks);
+                downloader.setDownloadDirectory(dirName);
+                downloader.setOptions(downloadOptions);
+                downloader.setSources(sources);
+                downloader.setLinkResolver(relink);
+                downloader.startDownloads();
+            }
+            else
+            {
+                /* downloads start as soon as the first link is resolved, progress is logged above the dashboard */
+                Downloader downloader({});
+                downloader.setDownloadDirectory(dirName);
+                downloader.setOptions(downloadOptions);
+                downloader.setLinkResolver(relink);
+                downloader.open();
+                resolve_episodes(
+                    pages, targetRes, audioLang, &manifest,
+                    [&downloader](const std::string &message)
+                    {
+                        downloader.log(message);
+                    },
+                    [&downloader](const ResolvedEpisode &episode)
+                    {
+                        downloader.enqueue(episode.directLink, DownloadOrigin{episode.source, episode.page, episode.variant});
+                    });
+                downloader.close();
+            }
             fmt::print("\n\x1b[2K\r");
 
             /* create zip of downloaded items */
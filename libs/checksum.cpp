@@ -0,0 +1,144 @@
+#include "checksum.hpp"
+#include <fmt/core.h>
+#include <utility>
+
+/* ECMA-182 polynomial, bit-reversed */
+static const uint64_t POLY = 0xC96C5795D7870F42ull;
+
+/* slicing-by-8 tables, table[k][n] is the crc of byte n followed by k zero bytes */
+struct Crc64Tables
+{
+    uint64_t table[8][256];
+
+    Crc64Tables()
+    {
+        for (uint64_t n = 0; n < 256; ++n)
+        {
+            uint64_t crc = n;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            table[0][n] = crc;
+        }
+        for (int k = 1; k < 8; ++k)
+        {
+            for (int n = 0; n < 256; ++n)
+            {
+                uint64_t previous = table[k - 1][n];
+                table[k][n] = (previous >> 8) ^ table[0][previous & 0xff];
+            }
+        }
+    }
+};
+
+static const Crc64Tables &tables()
+{
+    static const Crc64Tables instance;
+    return instance;
+}
+
+uint64_t Crc64::update(uint64_t crc, const char *data, size_t size)
+{
+    const auto &t = tables().table;
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    crc = ~crc;
+
+    while (size >= 8)
+    {
+        /* assembled byte by byte, the compiler turns this into one load on little-endian targets */
+        uint64_t word = static_cast<uint64_t>(bytes[0]) | static_cast<uint64_t>(bytes[1]) << 8 |
+                        static_cast<uint64_t>(bytes[2]) << 16 | static_cast<uint64_t>(bytes[3]) << 24 |
+                        static_cast<uint64_t>(bytes[4]) << 32 | static_cast<uint64_t>(bytes[5]) << 40 |
+                        static_cast<uint64_t>(bytes[6]) << 48 | static_cast<uint64_t>(bytes[7]) << 56;
+        crc ^= word;
+        crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff] ^ t[5][(crc >> 16) & 0xff] ^ t[4][(crc >> 24) & 0xff] ^
+              t[3][(crc >> 32) & 0xff] ^ t[2][(crc >> 40) & 0xff] ^ t[1][(crc >> 48) & 0xff] ^ t[0][crc >> 56];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size > 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes) & 0xff];
+        bytes++;
+        size--;
+    }
+    return ~crc;
+}
+
+/* GF(2) matrix helpers, rows[n] is the image of bit n */
+static uint64_t multiply(const uint64_t *rows, uint64_t vector)
+{
+    uint64_t sum = 0;
+    for (int n = 0; vector; ++n, vector >>= 1)
+    {
+        if (vector & 1)
+        {
+            sum ^= rows[n];
+        }
+    }
+    return sum;
+}
+
+static void square(uint64_t *result, const uint64_t *rows)
+{
+    for (int n = 0; n < 64; ++n)
+    {
+        result[n] = multiply(rows, rows[n]);
+    }
+}
+
+Crc64::Shift::Shift(size_t length)
+{
+    for (int n = 0; n < 64; ++n)
+    {
+        rows_[n] = 1ull << n;
+    }
+
+    /* operator for one zero bit, then squared up to one zero byte */
+    uint64_t odd[64];
+    uint64_t even[64];
+    odd[0] = POLY;
+    for (int n = 1; n < 64; ++n)
+    {
+        odd[n] = 1ull << (n - 1);
+    }
+    square(even, odd);
+    square(odd, even);
+
+    /* apply length zero bytes, one squaring per bit of length */
+    uint64_t *current = odd;
+    uint64_t *next = even;
+    while (length)
+    {
+        square(next, current);
+        std::swap(current, next);
+        if (length & 1)
+        {
+            for (int n = 0; n < 64; ++n)
+            {
+                rows_[n] = multiply(current, rows_[n]);
+            }
+        }
+        length >>= 1;
+    }
+}
+
+uint64_t Crc64::Shift::apply(uint64_t crc) const
+{
+    return multiply(rows_, crc);
+}
+
+uint64_t Crc64::combine(uint64_t first, uint64_t second, size_t secondLength)
+{
+    if (secondLength == 0)
+    {
+        return first;
+    }
+    return Shift(secondLength).apply(first) ^ second;
+}
+
+std::string Crc64::format(uint64_t crc)
+{
+    return fmt::format("crc64:{:016x}", crc);
+}
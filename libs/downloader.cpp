@@ -1,18 +1,36 @@
 #include "downloader.hpp"
+#include "partfile.hpp"
+#include "filewriter.hpp"
+#include "ratelimiter.hpp"
+#include "progress.hpp"
+#include "sessionpool.hpp"
+#include "retrypolicy.hpp"
+#include "checksum.hpp"
+#include "manifest.hpp"
 #include <fmt/core.h>
 #include <fmt/color.h>
-#include <iostream>
 #include <fstream>
 #include <chrono>
 #include <ctime>
-#include <cmath>
 #include <iomanip>
 #include <sstream>
 #include <regex>
 #include <thread>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <functional>
 
 Downloader::Downloader(const std::vector<std::string> &urls) : urls_(urls) {}
 
+void Downloader::setOptions(const DownloadOptions &options)
+{
+    options_ = options;
+}
+
 void Downloader::setDownloadDirectory(const std::string &dir)
 {
     download_dir_ = dir;
@@ -20,38 +38,402 @@ void Downloader::setDownloadDirectory(const std::string &dir)
     {
         std::filesystem::create_directory(download_dir_);
     }
+    manifest_ = std::make_unique<Manifest>(download_dir_);
+}
+
+void Downloader::setSources(const std::vector<DownloadOrigin> &sources)
+{
+    sources_ = sources;
+}
+
+void Downloader::setLinkResolver(std::function<std::string(const std::string &)> resolver)
+{
+    resolver_ = std::move(resolver);
 }
 
 void Downloader::startDownloads()
 {
-    fmt::print("\n");
-    for (const auto &url : urls_)
+    RateLimiter::instance().setLimit(options_.rateLimit);
+    RateLimiter::instance().setSchedule(options_.rateSchedule);
+
+    std::vector<DownloadJob> jobs;
+    for (size_t i = 0; i < urls_.size(); ++i)
     {
-        std::string filename = extractFilename(url);
-        std::string filepath = download_dir_ + "/" + filename;
+        DownloadJob job = makeJob(urls_[i], i < sources_.size() ? sources_[i] : DownloadOrigin{});
 
-        fmt::print("\n * Downloading : ");
-        fmt::print(fmt::fg(fmt::color::cyan), fmt::format("{}\n", filename));
-        bool dlStatus = downloadFileWithRetry(url, filepath, MAX_RETRIES);
-        if (!dlStatus)
+        /* finished by an earlier run and untouched since */
+        if (manifest_ && manifest_->contains(job.filename))
         {
-            fmt::print("\n * DL (");
-            fmt::print(fmt::fg(fmt::color::indian_red), "FAIL");
-            fmt::print(")   : {}", url);
-            std::filesystem::remove(filepath);
+            fmt::print("\n * DL ({})   : {}", fmt::format(fmt::fg(fmt::color::cyan), "SKIP"), job.filename);
             continue;
         }
+        jobs.push_back(job);
+    }
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    probeJobs(jobs);
+    if (!admitJobs(jobs))
+    {
+        return;
+    }
+    orderJobs(jobs);
+
+    runJobs(jobs, std::max(1, std::min(options_.parallelDownloads, static_cast<int>(jobs.size()))));
+}
+
+Downloader::DownloadJob Downloader::makeJob(const std::string &url, const DownloadOrigin &origin) const
+{
+    DownloadJob job;
+    job.url = url;
+    job.filename = extractFilename(url);
+    job.filepath = download_dir_ + "/" + job.filename;
+    job.source = origin.source;
+    job.page = origin.page;
+    job.variant = origin.variant;
+    return job;
+}
+
+void Downloader::open()
+{
+    RateLimiter::instance().setLimit(options_.rateLimit);
+    RateLimiter::instance().setSchedule(options_.rateSchedule);
+
+    std::error_code ec;
+    auto space = std::filesystem::space(download_dir_.empty() ? "." : download_dir_, ec);
+    spaceKnown_ = !ec;
+    available_ = !ec && space.available > FREE_SPACE_MARGIN ? space.available - FREE_SPACE_MARGIN : 0;
+    committed_ = 0;
+
+    startWorkers(std::max(1, options_.parallelDownloads), 0);
+}
+
+void Downloader::enqueue(const std::string &url, const DownloadOrigin &origin)
+{
+    DownloadJob job = makeJob(url, origin);
+    if (manifest_ && manifest_->contains(job.filename))
+    {
+        progress_.log(fmt::format(" * DL ({})   : {}", fmt::format(fmt::fg(fmt::color::cyan), "SKIP"), job.filename));
+        return;
+    }
+
+    job.remote = probeRemote(job.url);
+    job.expectedSize = job.remote.size;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (spaceKnown_)
+    {
+        size_t remaining = remainingBytes(job);
+        if (committed_ + remaining > available_)
+        {
+            size_t left = available_ - committed_;
+            lock.unlock();
+            progress_.log(fmt::format(" * Skipped ({})   : {} [{}], {} available", fmt::format(fmt::fg(fmt::color::indian_red), "SPACE"),
+                                      job.filename, formatSizeMB(job.expectedSize), formatSizeMB(left)));
+            return;
+        }
+        committed_ += remaining;
+    }
+
+    /* resolved links expire, do not run far ahead of the download slots */
+    cv_.wait(lock, [this]()
+    {
+        return queue_.size() < static_cast<size_t>(std::max(1, options_.parallelDownloads));
+    });
+    jobs_.push_back(std::move(job));
+    queue_.push_back(&jobs_.back());
+    if (batch_)
+    {
+        progress_.addJob();
+    }
+    cv_.notify_all();
+}
+
+void Downloader::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        accepting_ = false;
+    }
+    cv_.notify_all();
+    joinWorkers();
+}
+
+void Downloader::log(const std::string &message)
+{
+    progress_.log(message);
+}
+
+void Downloader::probeJobs(std::vector<DownloadJob> &jobs)
+{
+    /* Probe sizes on as many connections as the scheduler will use */
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> probes;
+    size_t probeCount = std::min<size_t>(std::max(1, options_.parallelDownloads), jobs.size());
+    for (size_t i = 0; i < probeCount; ++i)
+    {
+        probes.emplace_back([&]()
+        {
+            for (size_t idx = next++; idx < jobs.size(); idx = next++)
+            {
+                jobs[idx].remote = probeRemote(jobs[idx].url);
+                jobs[idx].expectedSize = jobs[idx].remote.size;
+            }
+        });
+    }
+    for (auto &t : probes)
+    {
+        t.join();
+    }
+}
+
+bool Downloader::admitJobs(std::vector<DownloadJob> &jobs)
+{
+    std::error_code ec;
+    auto space = std::filesystem::space(download_dir_.empty() ? "." : download_dir_, ec);
+    if (ec)
+    {
+        /* cannot tell, let the preallocation catch it */
+        return true;
+    }
+    size_t available = space.available > FREE_SPACE_MARGIN ? space.available - FREE_SPACE_MARGIN : 0;
+
+    /**
+     * Admit files in the requested order while they fit, counting what a .part
+     * file from an earlier run already holds. Files of unknown size are let through. */
+    std::vector<DownloadJob> admitted;
+    std::vector<const DownloadJob *> skipped;
+    size_t needed = 0;
+    size_t wanted = 0;
+    for (const auto &job : jobs)
+    {
+        size_t remaining = remainingBytes(job);
+        wanted += remaining;
+        if (needed + remaining <= available)
+        {
+            needed += remaining;
+            admitted.push_back(job);
+        }
         else
         {
-            /* Move cursor up */
-            std::cout << "\x1b[1A";
-            /* Clear the entire line */
-            std::cout << "\x1b[2K\r";
+            skipped.push_back(&job);
+        }
+    }
+
+    if (skipped.empty())
+    {
+        return true;
+    }
+
+    fmt::print("\n * Not enough free space : {} needed, {} available in {}",
+               formatSizeMB(wanted), formatSizeMB(available), download_dir_);
+    for (const auto *job : skipped)
+    {
+        fmt::print("\n * Skipped ({})   : {} [{}]", fmt::format(fmt::fg(fmt::color::indian_red), "SPACE"), job->filename, formatSizeMB(job->expectedSize));
+    }
+    if (admitted.empty())
+    {
+        fmt::print("\n");
+        return false;
+    }
+
+    jobs = std::move(admitted);
+    return true;
+}
+
+size_t Downloader::remainingBytes(const DownloadJob &job) const
+{
+    /* what a .part file from an earlier run already holds is not needed again */
+    std::error_code ec;
+    size_t onDisk = std::filesystem::file_size(PartFile::partPath(job.filepath), ec);
+    return job.expectedSize - (ec ? 0 : std::min(onDisk, job.expectedSize));
+}
+
+void Downloader::orderJobs(std::vector<DownloadJob> &jobs)
+{
+    if (options_.order != DownloadOrder::LargestFirst)
+    {
+        return;
+    }
+
+    std::stable_sort(jobs.begin(), jobs.end(), [](const DownloadJob &a, const DownloadJob &b)
+    {
+        return a.expectedSize > b.expectedSize;
+    });
+}
+
+void Downloader::runJobs(std::vector<DownloadJob> &jobs, int workerCount)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto &job : jobs)
+        {
+            jobs_.push_back(std::move(job));
+            queue_.push_back(&jobs_.back());
+        }
+    }
+    startWorkers(workerCount, jobs.size());
+    close();
+}
+
+void Downloader::startWorkers(int workerCount, size_t expectedJobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        accepting_ = true;
+        active_ = 0;
+        failures_ = 0;
+        /* one worker is the plain sequential run, without the batch header and summary */
+        batch_ = workerCount > 1;
+    }
+
+    if (!batch_)
+    {
+        fmt::print("\n");
+    }
+    else if (expectedJobs > 0)
+    {
+        fmt::print("\n\n * Downloading : {} files, {} at a time", expectedJobs, workerCount);
+    }
+    else
+    {
+        fmt::print("\n\n * Downloading : {} at a time", workerCount);
+    }
+
+    startTime_ = std::chrono::steady_clock::now();
+    startBytes_ = progress_.received;
+    progress_.setJobs(batch_ ? queue_.size() : 0);
+    progress_.start();
+
+    for (int i = 0; i < workerCount; ++i)
+    {
+        workers_.emplace_back(&Downloader::workerLoop, this);
+    }
+}
+
+void Downloader::joinWorkers()
+{
+    for (auto &t : workers_)
+    {
+        t.join();
+    }
+    workers_.clear();
+
+    progress_.stop();
+    if (!batch_ || jobs_.empty())
+    {
+        return;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+    size_t received = progress_.received - startBytes_;
+    progress_.log(fmt::format(" * Downloaded : {}/{} files, {} in {} ({})",
+                              jobs_.size() - failures_, jobs_.size(), formatSizeMB(received), formatTime(elapsed),
+                              formatSpeedMB(elapsed > 0 ? received / elapsed : 0.0)));
+}
+
+void Downloader::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true)
+    {
+        if (queue_.empty())
+        {
+            /* a running job may still come back for a retry, or a new one be enqueued */
+            if (active_ == 0 && !accepting_)
+            {
+                return;
+            }
+            cv_.wait(lock);
+            continue;
+        }
 
-            fmt::print(" * DL (");
-            fmt::print(fmt::fg(fmt::color::lime_green), "DONE");
-            fmt::print(")   : {}", filename);
+        auto now = std::chrono::steady_clock::now();
+        auto ready = std::find_if(queue_.begin(), queue_.end(), [&now](const DownloadJob *job)
+        {
+            return job->notBefore <= now;
+        });
+        if (ready == queue_.end())
+        {
+            auto soonest = (*std::min_element(queue_.begin(), queue_.end(), [](const DownloadJob *a, const DownloadJob *b)
+            {
+                return a->notBefore < b->notBefore;
+            }))->notBefore;
+            cv_.wait_until(lock, soonest);
+            continue;
         }
+
+        /* host's circuit breaker is open, leave the job queued and let other hosts' jobs run */
+        DownloadJob *job = *ready;
+        std::chrono::steady_clock::time_point retryAt;
+        if (!RetryPolicy::instance().allow(job->url, &retryAt))
+        {
+            job->notBefore = retryAt;
+            continue;
+        }
+        queue_.erase(ready);
+        active_++;
+        /* a slot was taken, enqueue() may hand over the next file */
+        cv_.notify_all();
+
+        lock.unlock();
+        RequestResult result = downloadFile(*job);
+        RetryPolicy::instance().record(job->url, result);
+        if (result.ok() && manifest_)
+        {
+            manifest_->record(ManifestEntry{job->filename, 0, job->checksum, job->url, job->source, job->page, job->variant});
+        }
+        /* the direct link expired, ask for a new one once instead of failing the file */
+        bool relinked = false;
+        if ((result.status == 403 || result.status == 410) && resolver_ && !job->source.empty() && !job->relinked)
+        {
+            std::string fresh;
+            try
+            {
+                fresh = resolver_(job->source);
+            }
+            catch (const std::exception &)
+            {
+            }
+            if (!fresh.empty())
+            {
+                job->url = fresh;
+                job->remote = RemoteInfo{};
+                job->relinked = relinked = true;
+            }
+        }
+        lock.lock();
+        active_--;
+
+        if (relinked)
+        {
+            job->notBefore = std::chrono::steady_clock::now();
+            queue_.push_back(job);
+            progress_.log(fmt::format(" * Link expired, resolved again : {}", job->filename));
+        }
+        else if (result.ok())
+        {
+            progress_.jobFinished();
+            progress_.log(fmt::format(" * DL ({})   : {}", fmt::format(fmt::fg(fmt::color::lime_green), "DONE"), job->filename));
+        }
+        else if (result.kind == RequestResult::Transient && ++job->attempts < MAX_RETRIES)
+        {
+            /* Jittered backoff, without holding a worker */
+            auto delay = job->backoff.next(result);
+            job->notBefore = std::chrono::steady_clock::now() + delay;
+            queue_.push_back(job);
+            progress_.log(fmt::format(" * Retry {}/{} in {:.1f}s : {}", job->attempts, MAX_RETRIES - 1,
+                                      std::chrono::duration<double>(delay).count(), job->filename));
+        }
+        else
+        {
+            failures_++;
+            progress_.jobFinished();
+            progress_.log(fmt::format(" * DL ({})   : {}", fmt::format(fmt::fg(fmt::color::indian_red), "FAIL"), job->url));
+        }
+        cv_.notify_all();
     }
 }
 
@@ -76,138 +458,685 @@ std::string Downloader::extractFilename(const std::string &url) const
     return oss.str();
 }
 
-std::string formatTime(double totalSeconds) {
-    int seconds = static_cast<int>(std::round(totalSeconds)); /* Round to nearest second */
-    int hours = seconds / 3600;
-    int minutes = (seconds % 3600) / 60;
-    int secs = seconds % 60;
+/* Status and the headers needed to resume, filled line by line from a HeaderCallback */
+struct ResponseHead
+{
+    long status = 0;
+    std::string etag;
+    std::string lastModified;
+    size_t contentLength = 0;
+    size_t rangeBegin = 0;
+    size_t rangeTotal = 0;
+    std::string retryAfter;
+};
 
-    std::ostringstream oss;
-    oss << std::setw(2) << std::setfill('0') << hours << ":"
-        << std::setw(2) << std::setfill('0') << minutes << ":"
-        << std::setw(2) << std::setfill('0') << secs;
+static void parseHeaderLine(const std::string &line, ResponseHead &head)
+{
+    /* every redirect hop starts a new status line */
+    if (line.rfind("HTTP/", 0) == 0)
+    {
+        head = ResponseHead{};
+        size_t space = line.find(' ');
+        if (space != std::string::npos)
+        {
+            head.status = std::strtol(line.c_str() + space + 1, nullptr, 10);
+        }
+        return;
+    }
 
-    return oss.str();
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+    {
+        return;
+    }
+
+    std::string name = line.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    std::string value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+    if (name == "etag")
+    {
+        head.etag = value;
+    }
+    else if (name == "last-modified")
+    {
+        head.lastModified = value;
+    }
+    else if (name == "content-length")
+    {
+        head.contentLength = std::strtoull(value.c_str(), nullptr, 10);
+    }
+    else if (name == "retry-after")
+    {
+        head.retryAfter = value;
+    }
+    else if (name == "content-range")
+    {
+        /* bytes <begin>-<end>/<total> */
+        size_t space = value.find(' ');
+        size_t slash = value.find('/');
+        if (space != std::string::npos && slash != std::string::npos)
+        {
+            head.rangeBegin = std::strtoull(value.c_str() + space + 1, nullptr, 10);
+            head.rangeTotal = std::strtoull(value.c_str() + slash + 1, nullptr, 10);
+        }
+    }
 }
 
-std::string formatSpeedMB(double speedKBps) {
-    double mbps = speedKBps / (1024.0 * 1024.0);
+/**
+ * Body sink for a transfer. cpr's WriteCallback hands every chunk over as a fresh
+ * std::string, so downloads install their own curl write function instead and
+ * copy straight from curl's receive buffer into the writer's pooled buffers. */
+using ChunkSink = std::function<bool(const char *data, size_t size)>;
 
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2)
-        << std::setw(4) << mbps << " MB/s";
+/* One raw transfer, see performGet */
+struct Transfer
+{
+    ChunkSink sink;
+    CURL *handle = nullptr;
+    /* paused by the rate limiter, curl keeps the chunk and delivers it again on unpause */
+    bool paused = false;
+};
 
-    return oss.str();
+static size_t writeChunk(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    auto *transfer = static_cast<Transfer *>(userdata);
+    size_t bytes = size * nmemb;
+    if (!RateLimiter::instance().acquire(bytes))
+    {
+        transfer->paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    return transfer->sink(data, bytes) ? bytes : 0;
 }
 
-auto formatSizeMB = [](size_t bytes) -> std::string {
-    double mb = static_cast<double>(bytes) / (1024.0 * 1024.0);
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2) << mb << "MB";
-    return oss.str();
+/* Multi handle owned by one thread, connections themselves stay with each easy handle */
+struct ThreadMulti
+{
+    CURLM *handle = curl_multi_init();
+    ~ThreadMulti() { curl_multi_cleanup(handle); }
 };
 
-bool Downloader::downloadFile(const std::string &url, const std::string &filepath)
+static cpr::Response performGet(cpr::Session &session, Transfer &transfer)
 {
-    std::ofstream outfile(filepath, std::ios::binary);
-    if (!outfile.is_open())
+    session.PrepareGet();
+    CURL *handle = session.GetCurlHolder()->handle;
+    transfer.handle = handle;
+    transfer.paused = false;
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeChunk);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer);
+    /* larger reads mean fewer callbacks per buffer */
+    curl_easy_setopt(handle, CURLOPT_BUFFERSIZE, 512L * 1024L);
+
+    /**
+     * Drive the transfer through a multi handle instead of curl_easy_perform.
+     * A paused transfer has no socket activity to wake it, so this loop polls
+     * the rate limiter and unpauses as soon as tokens are available. */
+    thread_local ThreadMulti multi;
+    curl_multi_add_handle(multi.handle, handle);
+
+    CURLcode result = CURLE_OK;
+    int running = 1;
+    while (running)
     {
-        fmt::print("\n * Failed to open file: {}\n", filepath);
-        return false;
+        if (curl_multi_perform(multi.handle, &running) != CURLM_OK)
+        {
+            result = CURLE_RECV_ERROR;
+            break;
+        }
+        if (!running)
+        {
+            break;
+        }
+
+        curl_multi_poll(multi.handle, nullptr, 0, transfer.paused ? 10 : 1000, nullptr);
+        if (transfer.paused && RateLimiter::instance().ready())
+        {
+            transfer.paused = false;
+            curl_easy_pause(handle, CURLPAUSE_CONT);
+        }
     }
 
-    auto start_time = std::chrono::steady_clock::now();
-    std::string last_progress_line;
-    
-    cpr::Response r = cpr::Get(
-        cpr::Url{url},
-        cpr::WriteCallback{
-            [&outfile](std::string data, intptr_t)
-            {
-                outfile.write(data.data(), data.size());
-                return true;
-            }},
-        cpr::ProgressCallback{[&start_time, &last_progress_line](size_t downloadTotal, size_t downloadNow, size_t, size_t, intptr_t)
+    int pending;
+    while (CURLMsg *message = curl_multi_info_read(multi.handle, &pending))
+    {
+        if (message->msg == CURLMSG_DONE && message->easy_handle == handle)
+        {
+            result = message->data.result;
+        }
+    }
+    curl_multi_remove_handle(multi.handle, handle);
+
+    return session.Complete(result);
+}
+
+Downloader::RemoteInfo Downloader::probeRemote(const std::string &url) const
+{
+    RemoteInfo info;
+    ResponseHead head;
+    size_t received = 0;
+
+    /* Ask for a single byte, a server that ignores ranges answers 200 and gets cut off here */
+    cpr::Session session;
+    SessionPool::instance().attach(session);
+    session.SetUrl(cpr::Url{url});
+    session.SetHeader(cpr::Header{{"Range", "bytes=0-0"}});
+    session.SetHeaderCallback(cpr::HeaderCallback{
+        [&head](std::string header, intptr_t)
         {
-            if (downloadTotal > 0)
+            parseHeaderLine(header, head);
+            return true;
+        }});
+    session.SetWriteCallback(cpr::WriteCallback{
+        [&received](std::string data, intptr_t)
+        {
+            received += data.size();
+            return received <= 1;
+        }});
+    session.Get();
+
+    info.etag = head.etag;
+    info.lastModified = head.lastModified;
+
+    if (head.status == 206 && head.rangeTotal > 0)
+    {
+        info.size = head.rangeTotal;
+        info.acceptsRanges = true;
+    }
+    else if (head.status == 200)
+    {
+        info.size = head.contentLength;
+    }
+
+    return info;
+}
+
+RequestResult Downloader::downloadFile(DownloadJob &job)
+{
+    /* progress from a segmented attempt is only fully reusable segmented, even on one connection */
+    PartFile previous;
+    const bool segmentedPart = previous.load(job.filepath) && !previous.segments.empty();
+    if (options_.connections != 1 || segmentedPart)
+    {
+        /* retries probe again, the file may have changed since */
+        RemoteInfo remote = job.attempts == 0 && job.remote.size > 0 ? job.remote : probeRemote(job.url);
+        if (remote.acceptsRanges && remote.size >= 2 * MIN_SEGMENT_SIZE)
+        {
+            return downloadSegmented(job, remote);
+        }
+    }
+
+    /* Server has no range support (or file is tiny), fall back to one stream */
+    return downloadSingleStream(job);
+}
+
+RequestResult Downloader::downloadSingleStream(DownloadJob &job)
+{
+    const std::string &url = job.url;
+    const std::string &filepath = job.filepath;
+    const std::string partpath = PartFile::partPath(filepath);
+    std::error_code ec;
+
+    /**
+     * Continue a previous single-stream attempt from the bytes it recorded.
+     * A segmented sidecar continues after its finished segments at the front, the mirror of
+     * the pickup in downloadSegmented(); segments past a gap are lost once the stream passes them.
+     * If-Range makes the server send the whole file again if it changed meanwhile. */
+    PartFile part;
+    size_t offset = 0;
+    /* checksum of the bytes before offset */
+    uint64_t baseChecksum = 0;
+    bool checksummed = true;
+    /* the .part holds segmented progress, never truncate it for a restart */
+    bool segmentedPart = false;
+    if (part.load(filepath) && std::filesystem::exists(partpath, ec))
+    {
+        const size_t onDisk = std::filesystem::file_size(partpath, ec);
+        if (!ec && part.segments.empty())
+        {
+            offset = std::min<size_t>(part.bytesWritten, onDisk);
+            baseChecksum = part.checksum;
+            checksummed = part.checksummed && offset == part.bytesWritten;
+        }
+        else if (!ec)
+        {
+            segmentedPart = true;
+            const PartFile::Segment &front = part.segments.front();
+            if (front.begin == 0 && front.end < onDisk)
             {
-                double progress = static_cast<double>(downloadNow) / downloadTotal * 100.0;
-                auto now = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-                
-                if (elapsed > 0)
-                {
-                    double speed = static_cast<double>(downloadNow) / elapsed;
-                    double remaining = (downloadTotal - downloadNow) / speed;
-                    
-                    /* Build the complete progress string */
-                    std::ostringstream progress_stream;
-                    progress_stream << std::fixed << std::setprecision(2)
-                    << " * Progress: " << progress
-                    << "% ETA: " << formatTime(remaining)
-                    << " | " << formatSpeedMB(speed)
-                    << " | [" << formatSizeMB(downloadNow) << "/" << formatSizeMB(downloadTotal) << "]";
-                    
-                    std::string new_line = progress_stream.str();
-                    
-                    /* Clear the current progress line and rewrite it */
-                    if (!last_progress_line.empty()) {
-                        /*  Clear the previous progress line */
-                        std::cout << "\r" << std::string(last_progress_line.length(), ' ') << "\r";
-                    }
-                    
-                    std::cout << new_line << std::flush;
-                    last_progress_line = new_line;
-                }
+                offset = front.end + 1;
+                baseChecksum = front.checksum;
+                checksummed = part.checksummed;
             }
+        }
+    }
+
+    cpr::Session session;
+    SessionPool::instance().attach(session);
+    session.SetUrl(cpr::Url{url});
+    if (offset > 0)
+    {
+        cpr::Header header{{"Range", fmt::format("bytes={}-", offset)}};
+        if (!part.validator().empty())
+        {
+            header["If-Range"] = part.validator();
+        }
+        session.SetHeader(header);
+    }
+
+    std::shared_ptr<FileWriter::Target> target;
+    std::unique_ptr<FileWriter::Stream> stream;
+    ResponseHead head;
+    size_t written = 0;
+    size_t lastSaved = 0;
+    bool mismatch = false;
+    bool openFailed = false;
+    bool kept = false;
+
+    auto slot = progress_.add(std::filesystem::path(filepath).filename().string(), part.totalSize, offset);
+
+    session.SetHeaderCallback(cpr::HeaderCallback{
+        [&head](std::string header, intptr_t)
+        {
+            parseHeaderLine(header, head);
             return true;
+        }});
+    Transfer transfer;
+    transfer.sink = [&](const char *data, size_t size)
+    {
+        /* headers are complete by the first body chunk, decide between append and restart */
+        if (!stream)
+        {
+            if (head.status != 200 && head.status != 206)
+            {
+                /* error page, leave the .part file alone */
+                return false;
+            }
+
+            bool resumed = head.status == 206 && offset > 0;
+            if (resumed && (head.rangeBegin != offset || (part.totalSize > 0 && head.rangeTotal != part.totalSize)))
+            {
+                mismatch = true;
+                return false;
+            }
+
+            if (!resumed && segmentedPart)
+            {
+                /* the range was not honoured, a restart would throw the segments away */
+                kept = true;
+                return false;
+            }
+            if (!resumed)
+            {
+                offset = 0;
+                baseChecksum = 0;
+                checksummed = true;
+            }
+            target = FileWriter::instance().open(partpath);
+            /* drop anything past the recorded length, or everything on a restart */
+            if (target->isOpen())
+            {
+                std::filesystem::resize_file(partpath, offset, ec);
+            }
+            if (!target->isOpen() || ec)
+            {
+                progress_.log(fmt::format(" * Failed to open file: {}", partpath));
+                openFailed = true;
+                return false;
+            }
+            /* with a known length, claim the space now rather than failing near the end */
+            const size_t totalSize = resumed ? head.rangeTotal : head.contentLength;
+            if (!target->reserve(totalSize))
+            {
+                progress_.log(fmt::format(" * Failed to allocate file: {} ({})", partpath, formatSizeMB(totalSize)));
+                openFailed = true;
+                return false;
+            }
+            stream = std::make_unique<FileWriter::Stream>(target, offset);
+
+            part = PartFile{};
+            part.url = url;
+            part.etag = head.etag;
+            part.lastModified = head.lastModified;
+            part.totalSize = totalSize;
+            part.bytesWritten = offset;
+            part.checksum = baseChecksum;
+            part.checksummed = checksummed;
+            part.save(filepath);
+
+            slot->total = part.totalSize;
+            slot->done = offset;
         }
-    });
 
-    /* Clear the final progress line but leave cursor positioned for cleanup */
-    if (!last_progress_line.empty()) {
-        std::cout << "\r" << std::string(last_progress_line.length(), ' ') << "\r";
+        if (!stream->append(data, size))
+        {
+            return false;
+        }
+        written += size;
+        slot->done += size;
+        progress_.received += size;
+
+        /* keep the sidecar close behind what the writer has put on disk, so a killed run loses little */
+        size_t durable = stream->durable();
+        if (durable - lastSaved >= SIDECAR_INTERVAL)
+        {
+            part.bytesWritten = offset + durable;
+            part.checksum = Crc64::combine(baseChecksum, stream->checksum(0, durable), durable);
+            part.save(filepath);
+            lastSaved = durable;
+        }
+        return true;
+    };
+
+    cpr::Response r = performGet(session, transfer);
+    RequestResult result = RetryPolicy::classify(head.status, r.error, head.retryAfter);
+
+    if (mismatch || (offset > 0 && head.status == 416))
+    {
+        /* server disagrees with the sidecar, start from zero next time */
+        PartFile::discard(filepath);
+        return RequestResult{RequestResult::Transient};
     }
+    if (openFailed)
+    {
+        return RequestResult{RequestResult::Permanent};
+    }
+    if (kept)
+    {
+        progress_.log(fmt::format(" * Server did not resume {}, keeping its segmented .part file (delete it to start over)", std::filesystem::path(filepath).filename().string()));
+        return RequestResult{RequestResult::Transient};
+    }
+    if (!stream)
+    {
+        /* an error page or a transfer that died before the body */
+        return result.ok() ? RequestResult{RequestResult::Transient} : result;
+    }
+
+    bool flushed = stream->finish();
+    part.bytesWritten = offset + stream->durable();
+    part.checksum = Crc64::combine(baseChecksum, stream->checksum(0, stream->durable()), stream->durable());
+    /* the handle must be closed before the .part file can be renamed on Windows */
+    stream.reset();
+    target.reset();
 
-    outfile.close();
-    return r.status_code == 200;
+    bool complete = !r.error && flushed &&
+                    (r.status_code == 200 || r.status_code == 206) &&
+                    (part.totalSize == 0 || part.bytesWritten == part.totalSize);
+    if (!complete)
+    {
+        part.save(filepath);
+        return result.ok() ? RequestResult{RequestResult::Transient} : result;
+    }
+
+    if (!PartFile::complete(filepath))
+    {
+        return RequestResult{RequestResult::Permanent};
+    }
+    job.checksum = part.checksummed ? Crc64::format(part.checksum) : "";
+    return RequestResult{};
 }
 
-bool Downloader::downloadFileWithRetry(const std::string &url, const std::string &filepath, int retries)
+RequestResult Downloader::downloadSegmented(DownloadJob &job, const RemoteInfo &remote)
 {
-    int attempt = 0;
-    int max_attempts = retries;
+    const std::string &url = job.url;
+    const std::string &filepath = job.filepath;
+    const std::string partpath = PartFile::partPath(filepath);
+    const size_t totalSize = remote.size;
+    std::error_code ec;
 
-    while (attempt < max_attempts)
+    /**
+     * Reuse a previous attempt if the server still serves the same file.
+     * A single-stream sidecar becomes one finished segment at the front. */
+    PartFile part;
+    bool resume = part.load(filepath) &&
+                  !part.validator().empty() &&
+                  part.etag == remote.etag &&
+                  part.lastModified == remote.lastModified &&
+                  (part.totalSize == totalSize || part.totalSize == 0) &&
+                  std::filesystem::exists(partpath, ec);
+    if (resume && part.segments.empty())
     {
-        if (attempt > 0)
+        size_t onDisk = std::min<size_t>(part.bytesWritten, std::filesystem::file_size(partpath, ec));
+        if (onDisk > 0)
         {
-            // Exponential backoff: 1s, 2s, 4s
-            int delay_seconds = 1 << (attempt - 1);
-            fmt::print("\n * Retry {}/{} in {}s...", attempt, max_attempts - 1, delay_seconds);
-            std::this_thread::sleep_for(std::chrono::seconds(delay_seconds));
+            part.checksummed = part.checksummed && onDisk == part.bytesWritten;
+            part.addSegment(0, onDisk - 1, part.checksum);
+        }
+    }
+
+    if (!resume)
+    {
+        part = PartFile{};
+        part.url = url;
+        part.etag = remote.etag;
+        part.lastModified = remote.lastModified;
 
-            /* Clear retry message */
-            std::cout << "\x1b[1A";
-            std::cout << "\x1b[2K\r";
+        /* Start from an empty file, reserve() below never shrinks one */
+        std::ofstream outfile(partpath, std::ios::binary | std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            progress_.log(fmt::format(" * Failed to open file: {}", partpath));
+            return RequestResult{RequestResult::Permanent};
         }
+    }
+    part.totalSize = totalSize;
+    part.bytesWritten = 0;
 
-        bool success = downloadFile(url, filepath);
+    auto target = FileWriter::instance().open(partpath);
+    if (!target->isOpen())
+    {
+        progress_.log(fmt::format(" * Failed to open file: {}", partpath));
+        return RequestResult{RequestResult::Permanent};
+    }
+    /* Reserve the whole file, so every segment can write at its own offset and a full disk fails now */
+    if (!target->reserve(totalSize))
+    {
+        progress_.log(fmt::format(" * Failed to allocate file: {} ({})", partpath, formatSizeMB(totalSize)));
+        return RequestResult{RequestResult::Permanent};
+    }
+    part.save(filepath);
+
+    /**
+     * Fixed mode splits the file into one range per connection.
+     * Auto mode uses small ranges so that connections added later still find work. */
+    const bool autoTune = options_.connections == 0;
+    size_t segmentSize = autoTune
+        ? AUTO_SEGMENT_SIZE
+        : std::max(MIN_SEGMENT_SIZE, (totalSize + options_.connections - 1) / options_.connections);
 
-        if (success)
+    std::vector<std::pair<size_t, size_t>> segments; /* inclusive [begin, end] */
+    for (const auto &[missingBegin, missingEnd] : part.missingSegments())
+    {
+        for (size_t begin = missingBegin; begin <= missingEnd; begin += segmentSize)
         {
-            return true;
+            segments.emplace_back(begin, std::min(begin + segmentSize - 1, missingEnd));
         }
+    }
+
+    std::mutex partMutex; /* guards part and its sidecar */
+    std::atomic<size_t> nextSegment{0};
+    auto slot = progress_.add(std::filesystem::path(filepath).filename().string(), totalSize, part.segmentBytes());
+    std::atomic<int> running{0};
+    std::atomic<bool> failed{false};
+    /* a segment hit an error that retrying the file will not fix */
+    std::atomic<bool> permanent{false};
+    /* status of the response that made it permanent, e.g. 403 once the link expired */
+    std::atomic<long> rejectedStatus{0};
+    const std::string validator = part.validator();
 
-        attempt++;
+    auto worker = [&]()
+    {
+        /* one session per connection, its handle keeps the connection open between segments */
+        cpr::Session session;
+        SessionPool::instance().attach(session);
+        session.SetUrl(cpr::Url{url});
 
-        /* If this wasn't the last attempt, clear the progress line */
-        if (attempt < max_attempts)
+        for (size_t idx = nextSegment++; idx < segments.size() && !failed; idx = nextSegment++)
         {
-            std::cout << "\x1b[1A";
-            std::cout << "\x1b[2K\r";
+            const auto [begin, end] = segments[idx];
+            /* first byte not yet confirmed on disk, retries continue from here */
+            size_t cursor = begin;
+            Backoff backoff(std::chrono::milliseconds(500), std::chrono::seconds(8));
+
+            for (int attempt = 0; attempt < MAX_RETRIES && cursor <= end && !failed; ++attempt)
+            {
+                if (attempt > 0)
+                {
+                    std::this_thread::sleep_for(backoff.next());
+                }
+                const size_t length = end - cursor + 1;
+                FileWriter::Stream stream(target, cursor);
+                size_t written = 0;
+                size_t lastSaved = 0;
+
+                cpr::Header header{{"Range", fmt::format("bytes={}-{}", cursor, end)}};
+                if (!validator.empty())
+                {
+                    header["If-Range"] = validator;
+                }
+                session.SetHeader(header);
+
+                Transfer transfer;
+                transfer.sink = [&](const char *data, size_t size)
+                {
+                    /* a 200 means If-Range failed or the range was ignored, never write it at this offset */
+                    if (written == 0)
+                    {
+                        long status = 0;
+                        curl_easy_getinfo(session.GetCurlHolder()->handle, CURLINFO_RESPONSE_CODE, &status);
+                        if (status != 206)
+                        {
+                            return false;
+                        }
+                    }
+                    /* a server that ignores the range would overrun the segment */
+                    if (written + size > length)
+                    {
+                        return false;
+                    }
+                    if (!stream.append(data, size))
+                    {
+                        return false;
+                    }
+                    written += size;
+                    slot->done += size;
+                    progress_.received += size;
+
+                    /* record partial progress, so a killed run keeps most of this segment */
+                    size_t durable = stream.durable();
+                    if (durable - lastSaved >= SIDECAR_INTERVAL)
+                    {
+                        std::lock_guard<std::mutex> lock(partMutex);
+                        part.addSegment(cursor + lastSaved, cursor + durable - 1, stream.checksum(lastSaved, durable));
+                        part.save(filepath);
+                        lastSaved = durable;
+                    }
+                    return !failed.load();
+                };
+
+                cpr::Response r = performGet(session, transfer);
+
+                bool flushed = stream.finish();
+                /* the status was checked on the first chunk, so whatever reached the disk is good */
+                size_t confirmed = flushed ? stream.durable() : lastSaved;
+                slot->done -= written - confirmed;
+
+                if (confirmed > lastSaved)
+                {
+                    std::lock_guard<std::mutex> lock(partMutex);
+                    part.addSegment(cursor + lastSaved, cursor + confirmed - 1, stream.checksum(lastSaved, confirmed));
+                    part.save(filepath);
+                }
+                cursor += confirmed;
+
+                if (!target->ok())
+                {
+                    /* the disk refused a write, retrying will not help */
+                    permanent = true;
+                    failed = true;
+                }
+                else if (cursor <= end && RetryPolicy::classify(r.status_code, r.error).kind == RequestResult::Permanent)
+                {
+                    rejectedStatus = r.status_code;
+                    permanent = true;
+                    failed = true;
+                }
+                else if (cursor <= end && r.status_code == 200)
+                {
+                    /* If-Range failed, the file changed under us; the next attempt probes it again */
+                    failed = true;
+                }
+            }
+
+            if (cursor <= end)
+            {
+                failed = true;
+                break;
+            }
         }
+        running--;
+    };
+
+    std::vector<std::thread> workers;
+    size_t initialWorkers = autoTune ? 2 : static_cast<size_t>(options_.connections);
+    for (size_t i = 0; i < initialWorkers && i < segments.size(); ++i)
+    {
+        running++;
+        workers.emplace_back(worker);
+    }
+
+    /* Auto-tune: keep adding connections while each one still raises throughput */
+    bool tuning = autoTune;
+    double lastRate = 0.0;
+    auto sampleTime = std::chrono::steady_clock::now();
+    size_t sampleBytes = slot->done;
+
+    while (running > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        auto now = std::chrono::steady_clock::now();
+        double window = std::chrono::duration<double>(now - sampleTime).count();
+        if (tuning && window >= 2.0)
+        {
+            size_t bytesNow = slot->done;
+            double rate = (bytesNow - std::min(bytesNow, sampleBytes)) / window;
+
+            if (rate > lastRate * 1.1 && workers.size() < MAX_CONNECTIONS && nextSegment < segments.size())
+            {
+                lastRate = rate;
+                running++;
+                workers.emplace_back(worker);
+            }
+            else
+            {
+                tuning = false;
+            }
+            sampleTime = now;
+            sampleBytes = bytesNow;
+        }
+    }
+
+    for (auto &t : workers)
+    {
+        t.join();
     }
 
-    return false;
+    target.reset();
+    if (failed || part.segmentBytes() != totalSize)
+    {
+        RequestResult result{permanent ? RequestResult::Permanent : RequestResult::Transient};
+        result.status = rejectedStatus;
+        return result;
+    }
+
+    if (!PartFile::complete(filepath))
+    {
+        return RequestResult{RequestResult::Permanent};
+    }
+    /* every segment merged into one range covering the file */
+    job.checksum = part.checksummed ? Crc64::format(part.segments.front().checksum) : "";
+    return RequestResult{};
 }
@@ -0,0 +1,68 @@
+#include <episodesource.hpp>
+#include <algorithm>
+
+namespace AnimepaheCLI
+{
+    AudioLang parseAudioLang(const std::string &audio)
+    {
+        if (audio == "en")
+        {
+            return AudioLang::English;
+        }
+        if (audio == "zh")
+        {
+            return AudioLang::Chinese;
+        }
+        return AudioLang::Japanese;
+    }
+
+    SourceIndex::SourceIndex(const std::vector<EpisodeSource> &sources) : sources_(sources)
+    {
+        all_.reserve(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            all_.push_back(static_cast<uint16_t>(i));
+        }
+        /* stable, so equal resolutions keep the order the menu lists them in */
+        std::stable_sort(all_.begin(), all_.end(), [&](uint16_t a, uint16_t b)
+        {
+            return sources[a].resolution > sources[b].resolution;
+        });
+        for (uint16_t i : all_)
+        {
+            byLang_[static_cast<size_t>(sources[i].lang)].push_back(i);
+        }
+    }
+
+    const EpisodeSource *SourceIndex::pick(const std::vector<uint16_t> &group, int targetRes) const
+    {
+        if (targetRes == -1)
+        {
+            /* first of the lowest, not the last listed */
+            int lowest = sources_[group.back()].resolution;
+            auto found = std::find_if(group.begin(), group.end(), [&](uint16_t i) { return sources_[i].resolution == lowest; });
+            return &sources_[*found];
+        }
+        if (targetRes > 0)
+        {
+            auto found = std::find_if(group.begin(), group.end(), [&](uint16_t i) { return sources_[i].resolution == targetRes; });
+            if (found != group.end())
+            {
+                return &sources_[*found];
+            }
+        }
+        /* highest, also when the requested resolution is not offered */
+        return &sources_[group.front()];
+    }
+
+    const EpisodeSource *SourceIndex::select(AudioLang lang, int targetRes) const
+    {
+        const std::vector<uint16_t> &preferred = byLang_[static_cast<size_t>(lang)];
+        if (!preferred.empty())
+        {
+            return pick(preferred, targetRes);
+        }
+        /* fall back to every language when the wanted one is not offered */
+        return all_.empty() ? nullptr : pick(all_, targetRes);
+    }
+}
@@ -0,0 +1,496 @@
+#include "filewriter.hpp"
+#include "checksum.hpp"
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#ifdef ANIMEPAHE_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+/* requests handed to the disk per round, also the io_uring queue depth */
+static const size_t MAX_BATCH = 32;
+
+BufferPool::~BufferPool()
+{
+    for (char *buffer : free_)
+    {
+        ::operator delete(buffer, std::align_val_t{ALIGNMENT});
+    }
+}
+
+char *BufferPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this] { return !free_.empty() || allocated_ < capacity(); });
+
+    if (!free_.empty())
+    {
+        char *buffer = free_.back();
+        free_.pop_back();
+        return buffer;
+    }
+
+    allocated_++;
+    return static_cast<char *>(::operator new(BUFFER_SIZE, std::align_val_t{ALIGNMENT}));
+}
+
+void BufferPool::release(char *buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (allocated_ > capacity())
+        {
+            /* shrink back once streams have closed */
+            allocated_--;
+            ::operator delete(buffer, std::align_val_t{ALIGNMENT});
+            return;
+        }
+        free_.push_back(buffer);
+    }
+    cv_.notify_one();
+}
+
+void BufferPool::addStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        streams_++;
+    }
+    cv_.notify_all();
+}
+
+void BufferPool::removeStream()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    streams_--;
+    while (allocated_ > capacity() && !free_.empty())
+    {
+        allocated_--;
+        ::operator delete(free_.back(), std::align_val_t{ALIGNMENT});
+        free_.pop_back();
+    }
+}
+
+FileWriter::Target::~Target()
+{
+#ifdef _WIN32
+    if (handle_)
+    {
+        CloseHandle(static_cast<HANDLE>(handle_));
+    }
+#else
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+#endif
+}
+
+bool FileWriter::Target::isOpen() const
+{
+#ifdef _WIN32
+    return handle_ != nullptr;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+bool FileWriter::Target::reserve(size_t size)
+{
+    if (size == 0)
+    {
+        return isOpen();
+    }
+#ifdef _WIN32
+    HANDLE handle = static_cast<HANDLE>(handle_);
+    LARGE_INTEGER current;
+    if (!handle || !GetFileSizeEx(handle, &current))
+    {
+        return false;
+    }
+    if (static_cast<uint64_t>(current.QuadPart) >= size)
+    {
+        return true;
+    }
+    /* allocation first, so NTFS fails here when the volume is short on space */
+    FILE_ALLOCATION_INFO allocation{};
+    allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    FILE_END_OF_FILE_INFO eof{};
+    eof.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    return SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof(allocation)) &&
+           SetFileInformationByHandle(handle, FileEndOfFileInfo, &eof, sizeof(eof));
+#else
+    struct stat info;
+    if (fd_ < 0 || ::fstat(fd_, &info) != 0)
+    {
+        return false;
+    }
+#if defined(__linux__)
+    /* also fills holes below the current size, e.g. a .part file from a sparse run */
+    if (::fallocate(fd_, 0, 0, static_cast<off_t>(size)) == 0)
+    {
+        return true;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        return false;
+    }
+#elif defined(__APPLE__)
+    if (static_cast<size_t>(info.st_size) < size)
+    {
+        /* ask for one contiguous extent, settle for any */
+        fstore_t store{F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size - info.st_size), 0};
+        if (::fcntl(fd_, F_PREALLOCATE, &store) == -1)
+        {
+            store.fst_flags = F_ALLOCATEALL;
+            if (::fcntl(fd_, F_PREALLOCATE, &store) == -1 && errno == ENOSPC)
+            {
+                return false;
+            }
+        }
+    }
+#endif
+    /* filesystems without preallocation (some network shares) still get the final size, sparse */
+    if (static_cast<size_t>(info.st_size) >= size)
+    {
+        return true;
+    }
+    return ::ftruncate(fd_, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+/* positional write of the whole buffer, retried on short writes */
+bool FileWriter::writeAt(Target &target, const char *data, size_t length, size_t offset)
+{
+    while (length > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFull);
+        overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(target.handle_), data, static_cast<DWORD>(length), &written, &overlapped) || written == 0)
+        {
+            return false;
+        }
+#else
+        ssize_t written = ::pwrite(target.fd_, data, length, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+#endif
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+FileWriter::Stream::Stream(std::shared_ptr<Target> target, size_t offset)
+    : target_(std::move(target)), state_(std::make_shared<State>()), offset_(offset)
+{
+    FileWriter::instance().pool_.addStream();
+}
+
+FileWriter::Stream::~Stream()
+{
+    finish();
+    FileWriter::instance().pool_.removeStream();
+}
+
+bool FileWriter::Stream::append(const char *data, size_t size)
+{
+    BufferPool &pool = FileWriter::instance().pool_;
+    while (size > 0)
+    {
+        if (!buffer_)
+        {
+            buffer_ = pool.acquire();
+            filled_ = 0;
+        }
+
+        size_t count = std::min(size, BufferPool::BUFFER_SIZE - filled_);
+        std::memcpy(buffer_ + filled_, data, count);
+        filled_ += count;
+        data += count;
+        size -= count;
+
+        if (filled_ == BufferPool::BUFFER_SIZE)
+        {
+            submit();
+        }
+    }
+    return target_->ok();
+}
+
+void FileWriter::Stream::submit()
+{
+    if (!buffer_)
+    {
+        return;
+    }
+
+    if (filled_ == 0)
+    {
+        FileWriter::instance().pool_.release(buffer_);
+    }
+    else
+    {
+        /* hashed here while the buffer is still hot, not read back from disk later */
+        checksums_.push_back(Crc64::update(0, buffer_, filled_));
+        state_->pending++;
+        FileWriter::instance().enqueue(Request{target_, state_, buffer_, offset_, filled_});
+        offset_ += filled_;
+    }
+    buffer_ = nullptr;
+    filled_ = 0;
+}
+
+uint64_t FileWriter::Stream::checksum(size_t from, size_t to) const
+{
+    static const Crc64::Shift fullBuffer(BufferPool::BUFFER_SIZE);
+
+    uint64_t crc = 0;
+    for (size_t index = from / BufferPool::BUFFER_SIZE; index < checksums_.size(); ++index)
+    {
+        size_t begin = index * BufferPool::BUFFER_SIZE;
+        if (begin >= to)
+        {
+            break;
+        }
+        size_t length = std::min(BufferPool::BUFFER_SIZE, to - begin);
+        crc = length == BufferPool::BUFFER_SIZE ? fullBuffer.apply(crc) ^ checksums_[index]
+                                                : Crc64::combine(crc, checksums_[index], length);
+    }
+    return crc;
+}
+
+bool FileWriter::Stream::finish()
+{
+    submit();
+    FileWriter::instance().waitFor(*state_);
+    return target_->ok();
+}
+
+FileWriter &FileWriter::instance()
+{
+    static FileWriter writer;
+    return writer;
+}
+
+FileWriter::FileWriter()
+{
+#ifdef ANIMEPAHE_HAVE_IO_URING
+    /* kernels or sandboxes without io_uring keep the positional write path */
+    auto *ring = new io_uring;
+    if (io_uring_queue_init(MAX_BATCH, ring, 0) == 0)
+    {
+        ring_ = ring;
+    }
+    else
+    {
+        delete ring;
+    }
+#endif
+    thread_ = std::thread(&FileWriter::run, this);
+}
+
+FileWriter::~FileWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+#ifdef ANIMEPAHE_HAVE_IO_URING
+    if (ring_)
+    {
+        io_uring_queue_exit(static_cast<io_uring *>(ring_));
+        delete static_cast<io_uring *>(ring_);
+    }
+#endif
+}
+
+std::shared_ptr<FileWriter::Target> FileWriter::open(const std::string &path)
+{
+    auto target = std::make_shared<Target>();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        target->handle_ = handle;
+    }
+#else
+    target->fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+#endif
+    return target;
+}
+
+void FileWriter::enqueue(Request request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.push_back(std::move(request));
+    }
+    cv_.notify_one();
+}
+
+void FileWriter::run()
+{
+    std::vector<Request> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            while (!queue_.empty() && batch.size() < MAX_BATCH)
+            {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        writeBatch(batch);
+        batch.clear();
+    }
+}
+
+void FileWriter::writeBatch(std::vector<Request> &batch)
+{
+#ifdef ANIMEPAHE_HAVE_IO_URING
+    if (ring_)
+    {
+        auto *ring = static_cast<io_uring *>(ring_);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            io_uring_prep_write(sqe, batch[i].target->fd_, batch[i].buffer, static_cast<unsigned>(batch[i].length), batch[i].offset);
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(static_cast<uintptr_t>(i)));
+        }
+
+        /* the kernel may take fewer than asked, what it did not take stays queued in the ring */
+        size_t submitted = 0;
+        while (submitted < batch.size())
+        {
+            int rc = io_uring_submit(ring);
+            if (rc == -EINTR)
+            {
+                continue;
+            }
+            if (rc <= 0)
+            {
+                break;
+            }
+            submitted += static_cast<size_t>(rc);
+        }
+
+        /* every write the kernel took has to be reaped before its buffer goes back to the pool */
+        const int NOT_WRITTEN = INT_MIN;
+        std::vector<int> results(batch.size(), NOT_WRITTEN);
+        bool drained = true;
+        for (size_t done = 0; done < submitted; ++done)
+        {
+            io_uring_cqe *cqe = nullptr;
+            int rc;
+            while ((rc = io_uring_wait_cqe(ring, &cqe)) == -EINTR)
+            {
+            }
+            if (rc < 0)
+            {
+                drained = false;
+                break;
+            }
+            results[reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe))] = cqe->res;
+            io_uring_cqe_seen(ring, cqe);
+        }
+
+        if (!drained || submitted < batch.size())
+        {
+            /**
+             * The ring holds unsubmitted entries or completions that would be
+             * read as the next batch's, so it is not used again. Whatever has no
+             * result is written here before any buffer is released; writing the
+             * same bytes to the same offset twice is harmless. */
+            io_uring_queue_exit(ring);
+            delete ring;
+            ring_ = nullptr;
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if (results[i] == NOT_WRITTEN)
+                {
+                    results[i] = writeAt(*batch[i].target, batch[i].buffer, batch[i].length, batch[i].offset) ? static_cast<int>(batch[i].length) : -EIO;
+                }
+            }
+        }
+
+        /* completions arrive in any order, report them in submission order */
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            Request &request = batch[i];
+            bool ok = results[i] >= 0;
+            size_t written = ok ? static_cast<size_t>(results[i]) : 0;
+            if (ok && written < request.length)
+            {
+                ok = writeAt(*request.target, request.buffer + written, request.length - written, request.offset + written);
+            }
+            complete(request, ok);
+        }
+        return;
+    }
+#endif
+    for (auto &request : batch)
+    {
+        complete(request, writeAt(*request.target, request.buffer, request.length, request.offset));
+    }
+}
+
+void FileWriter::complete(Request &request, bool ok)
+{
+    if (!ok)
+    {
+        request.target->failed_ = true;
+    }
+    else if (request.target->ok())
+    {
+        request.state->durable += request.length;
+    }
+    pool_.release(request.buffer);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        request.state->pending--;
+    }
+    done_.notify_all();
+}
+
+void FileWriter::waitFor(const Stream::State &state)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_.wait(lock, [&state] { return state.pending == 0; });
+}
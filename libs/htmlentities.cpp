@@ -0,0 +1,213 @@
+#include <htmlentities.hpp>
+#include <htmlentities_table.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace AnimepaheCLI
+{
+    /* FNV-1a 64, must match fnv1a() in tools/gen_htmlentities.py */
+    static constexpr uint64_t entityHash(std::string_view name)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (char c : name)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    static constexpr size_t entitySlot(std::string_view name)
+    {
+        uint64_t h = entityHash(name);
+        return (h + HtmlEntityTable::displacement[h >> 54] * ((h >> 12) | 1)) % HtmlEntityTable::SLOTS;
+    }
+
+    static constexpr bool tableMatchesHash()
+    {
+        for (size_t i = 0; i < std::size(HtmlEntityTable::entities); ++i)
+        {
+            if (HtmlEntityTable::slots[entitySlot(HtmlEntityTable::entities[i].name)] != i + 1)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(tableMatchesHash(), "htmlentities_table.hpp does not match entityHash, regenerate it with tools/gen_htmlentities.py");
+
+    /* Windows-1252 for &#128;-&#159;, 0 where the byte is undefined and the code point is kept */
+    static constexpr uint16_t WINDOWS_1252[32] = {
+        0x20AC, 0, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017D, 0,
+        0, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0, 0x017E, 0x0178,
+    };
+
+    static bool isAlnum(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    static size_t encodeUtf8(uint32_t cp, char *out)
+    {
+        if (cp < 0x80)
+        {
+            out[0] = static_cast<char>(cp);
+            return 1;
+        }
+        if (cp < 0x800)
+        {
+            out[0] = static_cast<char>(0xC0 | (cp >> 6));
+            out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000)
+        {
+            out[0] = static_cast<char>(0xE0 | (cp >> 12));
+            out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xF0 | (cp >> 18));
+        out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 4;
+    }
+
+    std::string_view lookupHtmlEntity(std::string_view name)
+    {
+        if (name.empty() || name.size() > HtmlEntityTable::MAX_NAME)
+        {
+            return {};
+        }
+        uint16_t index = HtmlEntityTable::slots[entitySlot(name)];
+        if (index == 0 || HtmlEntityTable::entities[index - 1].name != name)
+        {
+            return {};
+        }
+        return HtmlEntityTable::entities[index - 1].value;
+    }
+
+    /**
+     * Reads the reference at ref ('&' included). Returns how many bytes it
+     * spans, 0 when it is not one, and leaves its UTF-8 in out (at most as
+     * long as the reference, the table is generated to keep that true). */
+    static size_t readReference(std::string_view ref, bool attribute, char *out, size_t &outLength)
+    {
+        if (ref.size() > 2 && ref[1] == '#')
+        {
+            size_t i = 2;
+            bool hex = ref[i] == 'x' || ref[i] == 'X';
+            i += hex ? 1 : 0;
+            size_t digits = i;
+            uint32_t cp = 0;
+            for (int v; i < ref.size() && (v = hex ? hexValue(ref[i]) : (ref[i] >= '0' && ref[i] <= '9' ? ref[i] - '0' : -1)) >= 0; ++i)
+            {
+                /* clamped, anything past U+10FFFF is invalid either way */
+                cp = cp > 0x10FFFF ? cp : cp * (hex ? 16 : 10) + v;
+            }
+            if (i == digits)
+            {
+                return 0;
+            }
+            i += i < ref.size() && ref[i] == ';' ? 1 : 0;
+
+            if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            {
+                cp = 0xFFFD;
+            }
+            else if (cp >= 0x80 && cp <= 0x9F && WINDOWS_1252[cp - 0x80])
+            {
+                cp = WINDOWS_1252[cp - 0x80];
+            }
+            outLength = encodeUtf8(cp, out);
+            return i;
+        }
+
+        size_t length = 0;
+        while (1 + length < ref.size() && length < HtmlEntityTable::MAX_NAME && isAlnum(ref[1 + length]))
+        {
+            length++;
+        }
+        if (length == 0)
+        {
+            return 0;
+        }
+
+        std::string_view value;
+        if (1 + length < ref.size() && ref[1 + length] == ';' && !(value = lookupHtmlEntity(ref.substr(1, length + 1))).empty())
+        {
+            std::memcpy(out, value.data(), value.size());
+            outLength = value.size();
+            return length + 2;
+        }
+
+        /* no semicolon: the longest legacy name the text starts with, &notit; reads as &not; then it; */
+        for (size_t n = std::min(length, HtmlEntityTable::MAX_LEGACY_NAME); n > 0; --n)
+        {
+            value = lookupHtmlEntity(ref.substr(1, n));
+            if (value.empty())
+            {
+                continue;
+            }
+            if (attribute && 1 + n < ref.size() && (ref[1 + n] == '=' || isAlnum(ref[1 + n])))
+            {
+                return 0;
+            }
+            std::memcpy(out, value.data(), value.size());
+            outLength = value.size();
+            return n + 1;
+        }
+        return 0;
+    }
+
+    void decodeHtmlEntities(std::string &text, bool attribute)
+    {
+        size_t read = text.find('&');
+        if (read == std::string::npos)
+        {
+            return;
+        }
+
+        /* output never outgrows what it replaces, so it is written over the input behind the read position */
+        char *data = text.data();
+        const size_t size = text.size();
+        size_t write = read;
+        while (read < size)
+        {
+            char decoded[HtmlEntityTable::MAX_NAME + 2];
+            size_t decodedLength = 0;
+            size_t consumed = readReference(std::string_view(data + read, size - read), attribute, decoded, decodedLength);
+            if (consumed == 0)
+            {
+                data[write++] = data[read++];
+            }
+            else
+            {
+                std::memcpy(data + write, decoded, decodedLength);
+                write += decodedLength;
+                read += consumed;
+            }
+
+            /* copy up to the next '&' in one go */
+            const void *next = std::memchr(data + read, '&', size - read);
+            size_t run = (next ? static_cast<const char *>(next) - data : size) - read;
+            std::memmove(data + write, data + read, run);
+            write += run;
+            read += run;
+        }
+        text.resize(write);
+    }
+}
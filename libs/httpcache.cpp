@@ -0,0 +1,338 @@
+#include "httpcache.hpp"
+#include "checksum.hpp"
+#include <nlohmann/json.hpp>
+#include <fmt/core.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+using json = nlohmann::json;
+
+static long long now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+HttpCache &HttpCache::instance()
+{
+    static HttpCache cache;
+    return cache;
+}
+
+HttpCache::HttpCache() : directory_(defaultDirectory()) {}
+
+void HttpCache::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    enabled_ = enabled;
+}
+
+void HttpCache::setDirectory(const std::string &directory)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    directory_ = directory;
+}
+
+std::string HttpCache::defaultDirectory()
+{
+#ifdef _WIN32
+    const char *base = std::getenv("LOCALAPPDATA");
+    return base && *base ? (std::filesystem::path(base) / "animepahe-cli" / "cache").string() : "";
+#else
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg)
+    {
+        return (std::filesystem::path(xdg) / "animepahe-cli").string();
+    }
+    const char *home = std::getenv("HOME");
+    return home && *home ? (std::filesystem::path(home) / ".cache" / "animepahe-cli").string() : "";
+#endif
+}
+
+std::string HttpCache::pathFor(const std::string &url) const
+{
+    /* the url itself is kept in the entry, a collision reads as a miss */
+    return fmt::format("{:016x}.json", Crc64::update(0, url.data(), url.size()));
+}
+
+bool HttpCache::load(const std::string &directory, const std::string &url, Entry &entry) const
+{
+    /* an entry that cannot be read is a miss, never a failed request */
+    try
+    {
+        return read(directory, url, entry);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+bool HttpCache::read(const std::string &directory, const std::string &url, Entry &entry) const
+{
+    const std::filesystem::path path = std::filesystem::path(directory) / pathFor(url);
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile.is_open())
+    {
+        return false;
+    }
+
+    /* one line of JSON describing the entry, then the body as it was received */
+    std::string header;
+    if (!std::getline(infile, header))
+    {
+        return false;
+    }
+    json parsed = json::parse(header, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object() || parsed.value("url", "") != url || !parsed.contains("size"))
+    {
+        return false;
+    }
+
+    /* the body is exactly the rest of the file, anything else was cut short or is an older format */
+    const size_t size = parsed.value("size", size_t{0});
+    if (std::filesystem::file_size(path) != header.size() + 1 + size)
+    {
+        return false;
+    }
+    std::string body(size, '\0');
+    if (!infile.read(body.data(), static_cast<std::streamsize>(size)))
+    {
+        return false;
+    }
+
+    entry.url = url;
+    entry.etag = parsed.value("etag", "");
+    entry.lastModified = parsed.value("lastModified", "");
+    entry.storedAt = parsed.value("storedAt", 0LL);
+    entry.body = std::move(body);
+    return true;
+}
+
+void HttpCache::store(const std::string &directory, const Entry &entry) const
+{
+    /* the response already succeeded, failing to keep it must not fail the request */
+    try
+    {
+        write(directory, entry);
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void HttpCache::write(const std::string &directory, const Entry &entry) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+    {
+        return;
+    }
+
+    /* write aside and rename, a reader never sees half an entry; the temp name is unique across threads and processes */
+    thread_local std::mt19937_64 rng(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    const std::filesystem::path target = std::filesystem::path(directory) / pathFor(entry.url);
+    const std::filesystem::path temp = fmt::format("{}.{:016x}.tmp", target.string(), rng());
+    {
+        std::ofstream outfile(temp, std::ios::binary | std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            return;
+        }
+        /* the body is kept raw, pages are not guaranteed to be UTF-8 and JSON strings must be */
+        outfile << json{
+            {"url", entry.url},
+            {"etag", entry.etag},
+            {"lastModified", entry.lastModified},
+            {"storedAt", entry.storedAt},
+            {"size", entry.body.size()}}.dump(-1, ' ', false, json::error_handler_t::replace)
+                << '\n';
+        outfile.write(entry.body.data(), static_cast<std::streamsize>(entry.body.size()));
+        if (!outfile.good())
+        {
+            outfile.close();
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+    }
+}
+
+/* "<16 hex digits>.json", what pathFor() names an entry */
+static bool isEntryName(const std::string &name, const std::string &suffix)
+{
+    if (name.size() < 16 + suffix.size() || name.compare(16, suffix.size(), suffix) != 0)
+    {
+        return false;
+    }
+    return std::all_of(name.begin(), name.begin() + 16, [](char c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+void HttpCache::sweep(const std::string &directory) const
+{
+    try
+    {
+        trim(directory);
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void HttpCache::trim(const std::string &directory) const
+{
+    struct Stored
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+    };
+    std::vector<Stored> entries;
+    uintmax_t total = 0;
+    std::error_code ec;
+    const auto now = std::filesystem::file_time_type::clock::now();
+
+    /* other files in the directory (links.json) belong to someone else */
+    for (const auto &file : std::filesystem::directory_iterator(directory, ec))
+    {
+        const std::string name = file.path().filename().string();
+        const bool entry = name.size() == 16 + 5 && isEntryName(name, ".json");
+        const bool temp = isEntryName(name, ".json.") && name.compare(name.size() - 4, 4, ".tmp") == 0;
+        if (!entry && !temp)
+        {
+            continue;
+        }
+        const auto modified = file.last_write_time(ec);
+        const uintmax_t size = file.file_size(ec);
+        if (ec)
+        {
+            ec.clear();
+            continue;
+        }
+
+        /* store() and a 304 rewrite the entry, its age is the time since it was last known current */
+        if ((temp && now - modified > TEMP_MAX_AGE) || (entry && now - modified > MAX_AGE))
+        {
+            std::filesystem::remove(file.path(), ec);
+            ec.clear();
+        }
+        else if (entry)
+        {
+            entries.push_back(Stored{file.path(), modified, size});
+            total += size;
+        }
+    }
+
+    if (total <= MAX_SIZE)
+    {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Stored &a, const Stored &b)
+    {
+        return a.modified < b.modified;
+    });
+    for (const Stored &stored : entries)
+    {
+        if (total <= MAX_SIZE)
+        {
+            break;
+        }
+        if (std::filesystem::remove(stored.path, ec))
+        {
+            total -= stored.size;
+        }
+        ec.clear();
+    }
+}
+
+cpr::Response HttpCache::respond(const Entry &entry)
+{
+    cpr::Response response;
+    response.status_code = 200;
+    response.text = entry.body;
+    response.url = cpr::Url{entry.url};
+    if (!entry.etag.empty())
+    {
+        response.header["etag"] = entry.etag;
+    }
+    if (!entry.lastModified.empty())
+    {
+        response.header["last-modified"] = entry.lastModified;
+    }
+    return response;
+}
+
+cpr::Response HttpCache::get(const std::string &url, std::chrono::seconds ttl, const std::function<cpr::Response(const cpr::Header &)> &send)
+{
+    std::string directory;
+    bool due = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (enabled_)
+        {
+            directory = directory_;
+            due = !swept_ && !directory.empty();
+            swept_ = swept_ || due;
+        }
+    }
+    if (directory.empty())
+    {
+        return send(cpr::Header{});
+    }
+    if (due)
+    {
+        sweep(directory);
+    }
+
+    Entry entry;
+    const bool cached = load(directory, url, entry);
+    if (cached && now() - entry.storedAt < ttl.count())
+    {
+        return respond(entry);
+    }
+
+    cpr::Header conditional;
+    if (cached && !entry.etag.empty())
+    {
+        conditional["If-None-Match"] = entry.etag;
+    }
+    if (cached && !entry.lastModified.empty())
+    {
+        conditional["If-Modified-Since"] = entry.lastModified;
+    }
+
+    cpr::Response response = send(conditional);
+    if (cached && !conditional.empty() && response.status_code == 304)
+    {
+        /* unchanged, the stored body is current again */
+        entry.storedAt = now();
+        store(directory, entry);
+        return respond(entry);
+    }
+
+    if (response.status_code == 200 && response.error.code == cpr::ErrorCode::OK)
+    {
+        Entry fresh;
+        fresh.url = url;
+        auto etag = response.header.find("etag");
+        fresh.etag = etag != response.header.end() ? etag->second : "";
+        auto lastModified = response.header.find("last-modified");
+        fresh.lastModified = lastModified != response.header.end() ? lastModified->second : "";
+        fresh.storedAt = now();
+        fresh.body = response.text;
+        store(directory, fresh);
+    }
+    return response;
+}
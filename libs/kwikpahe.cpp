@@ -1,271 +1,178 @@
 #include <kwikpahe.hpp>
 #include <utils.hpp>
 #include <cpr/cpr.h>
+#include <sessionpool.hpp>
+#include <retrypolicy.hpp>
+#include <patterns.hpp>
+#include <parsers.hpp>
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <re2/re2.h>
 #include <string>
 /* DECODER LIBS */
 #include <iostream>
-#include <cmath>
 #include <vector>
 #include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <iomanip>
 #include <cctype>
+#include <thread>
 
 namespace AnimepaheCLI
 {
-    std::string encodedString = "XXX"; // Encoded string
-    int zp = 17;                       // Not used in decoding
-    std::string alphabetKey = "XXX";   // Alphabet key
-    int offset = 1;                    // Offset
-    int base = 5;                      // Base
-    int placeholder = 24;              // Placeholder (unused)
-
-    std::string baseAlphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/";
-
-    int KwikPahe::_0xe16c(const std::string &IS, int Iy, int ms)
+    cpr::Response KwikPahe::get(const std::string &link) const
     {
-        std::string h = baseAlphabet.substr(0, Iy);
-        std::string i = baseAlphabet.substr(0, ms);
-
-        // Decode string IS from base Iy to int j
-        int j = 0;
-        for (int idx = 0; idx < IS.size(); ++idx)
-        {
-            char ch = IS[IS.size() - 1 - idx]; // reverse order
-            size_t pos = h.find(ch);
-            if (pos != std::string::npos)
-            {
-                j += static_cast<int>(pos) * static_cast<int>(std::pow(Iy, idx));
-            }
-        }
-
-        // Convert int j to base ms string
-        if (j == 0)
-            return i[0];
-
-        std::string k;
-        while (j > 0)
+        return RetryPolicy::instance().perform(link, [&link]()
         {
-            k = i[j % ms] + k;
-            j /= ms;
-        }
-
-        return std::stoi(k);
+            auto session = SessionPool::instance().acquire(link, SessionKind::Plain);
+            session->SetUrl(cpr::Url{link});
+            session->SetHeader(cpr::Header{});
+            return session->Get();
+        });
     }
 
-    std::string KwikPahe::decodeJSStyle(const std::string &Hb, int zp, const std::string &Wg, int Of, int Jg, int gj_placeholder)
-    {
-        std::string gj;
-
-        for (size_t i = 0; i < Hb.size(); ++i)
-        {
-            std::string s;
-            while (Hb[i] != Wg[Jg])
-            {
-                s += Hb[i];
-                i++;
-                if (i >= Hb.size())
-                    break;
-            }
-
-            for (size_t j = 0; j < Wg.size(); ++j)
-            {
-                std::string from(1, Wg[j]);
-                std::string to = std::to_string(j);
-                size_t pos;
-                while ((pos = s.find(from)) != std::string::npos)
-                {
-                    s.replace(pos, 1, to);
-                }
-            }
-
-            int code = _0xe16c(s, Jg, 10) - Of;
-            gj += static_cast<char>(code);
-        }
-
-        return gj;
-    }
-
-    std::string KwikPahe::fetch_kwik_direct(const std::string &kwikLink, const std::string &token, const std::string &kwik_session)
+    cpr::Response KwikPahe::post_kwik_form(const std::string &kwikLink, const Resolution &resolution) const
     {
         // Set up cookies
         cpr::Header headers = cpr::Header{
             {"referer", kwikLink},
-            {"cookie", "kwik_session=" + kwik_session},
+            {"cookie", "kwik_session=" + resolution.session},
         };
         // Set up form data
-        cpr::Payload data = cpr::Payload{{"_token", token}};
+        cpr::Payload data = cpr::Payload{{"_token", resolution.token}};
 
         // Make POST request with redirects disabled
-        cpr::Response response = cpr::Post(
-            cpr::Url{kwikLink},
-            headers,
-            data,
-            cpr::Redirect(false),
-            cpr::HttpVersion{cpr::HttpVersionCode::VERSION_1_1}
-        );
-
-        // Check if status code is 302 (redirect)
-        if (response.status_code == 302)
+        // Single attempt through the policy, fetch_kwik_dlink knows whether the token is worth sending again
+        return RetryPolicy::instance().perform(resolution.action, [&]()
         {
-            // Extract the redirect location from the response header
-            std::string redirectLocation;
-            re2::StringPiece rawHeader(response.raw_header);
-            if (RE2::FindAndConsume(&rawHeader, R"re(ocation:\s*(https?://\S+))re", &redirectLocation))
-            {
-                return redirectLocation;
-            }
-            throw std::runtime_error(fmt::format("Redirect Location not found in response from {}", kwikLink));
-        }
-        else
-        {
-            throw std::runtime_error(fmt::format("Redirect Location not found in response from {}", kwikLink));
-        }
+            auto session = SessionPool::instance().acquire(resolution.action, SessionKind::Form);
+            session->SetUrl(cpr::Url{resolution.action});
+            session->SetHeader(headers);
+            session->SetPayload(data);
+            session->SetRedirect(cpr::Redirect(false));
+            session->SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_1_1});
+            return session->Post();
+        }, 1);
     }
 
-    std::string KwikPahe::fetch_kwik_dlink(const std::string &kwikLink, int retries)
+    std::string KwikPahe::fetch_kwik_dlink(const std::string &kwikLink, int retries) const
     {
-        if (retries <= 0)
-        {
-            throw std::runtime_error(fmt::format("Kwik fetch failed: exceeded retry limit : {}", kwikLink));
-        }
+        Resolution resolution;
+        Backoff backoff(std::chrono::milliseconds(500), std::chrono::seconds(8));
+        int failures = 0;
+        std::string lastError;
 
-        cpr::Response response = cpr::Get(cpr::Url{kwikLink});
-        if (response.status_code != 200)
+        /* a failed step waits, then resumes from the earliest stage whose result is no longer good */
+        auto fail = [&](Resolution::Stage resumeAt, const RequestResult &result, std::string reason)
         {
-            throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", kwikLink, response.status_code));
-        }
-
-        // Clean the response text
-        std::string cleanText = response.text;
-        RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
-        
-        // Extract session from headers
-        std::string kwik_session;
-        re2::StringPiece input(response.raw_header);
-        RE2::FindAndConsume(&input, R"re(kwik_session=([^;]*);)re", &kwik_session);
-
-        std::string link, token;
-        std::string directLink;
-
-        // Try to extract encoded parameters - use separate StringPiece for each attempt
-        re2::StringPiece encode_text(cleanText);
-        std::string temp_encoded, temp_alphabet, temp_offset_str, temp_base_str;
-        
-        bool found_encoded = RE2::FindAndConsume(
-            &encode_text,
-            R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
-            &temp_encoded, &temp_alphabet, &temp_offset_str, &temp_base_str
-        );
+            resolution.stage = resumeAt;
+            lastError = std::move(reason);
+            if (++failures < retries)
+            {
+                std::this_thread::sleep_for(backoff.next(result));
+            }
+        };
 
-        if (!found_encoded || temp_encoded.empty() || temp_alphabet.empty())
+        while (resolution.stage != Resolution::Done)
         {
-            return fetch_kwik_dlink(kwikLink, retries - 1);
-        }
-
-        // Update global variables only if extraction succeeded
-        encodedString = temp_encoded;
-        alphabetKey = temp_alphabet;  
-        offset = std::stoi(temp_offset_str);
-        base = std::stoi(temp_base_str);
+            if (failures >= retries)
+            {
+                throw std::runtime_error(fmt::format("Kwik fetch failed: exceeded retry limit : {} ({})", kwikLink, lastError));
+            }
 
-        try 
-        {
-            std::string decodedString = decodeJSStyle(encodedString, zp, alphabetKey, offset, base, placeholder);
-            
-            // Use fresh StringPiece objects for each search
-            re2::StringPiece link_search(decodedString);
-            re2::StringPiece token_search(decodedString);
-            
-            bool found_link = RE2::FindAndConsume(&link_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &link);
-            bool found_token = RE2::FindAndConsume(&token_search, R"re(name="_token"[^"]*"(\S*)">)re", &token);
+            switch (resolution.stage)
+            {
+            case Resolution::FetchPage:
+            {
+                /* transient failures are already retried by the policy */
+                cpr::Response response = get(kwikLink);
+                if (response.status_code != 200)
+                {
+                    throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", kwikLink, response.status_code));
+                }
 
-            if (!found_link || !found_token || link.empty() || token.empty())
+                // Extract session from headers
+                resolution.session.clear();
+                re2::StringPiece input(response.raw_header);
+                RE2::FindAndConsume(&input, Patterns::get().kwikSession, &resolution.session);
+                resolution.page = std::move(response.text);
+                resolution.stage = Resolution::ReadForm;
+                break;
+            }
+            case Resolution::ReadForm:
             {
-                return fetch_kwik_dlink(kwikLink, retries - 1);
+                // Decoding context lives on this call's stack, resolvers run in parallel
+                resolution.action.clear();
+                resolution.token.clear();
+                if (!extractKwikForm(resolution.page, resolution.action, resolution.token))
+                {
+                    /* the page is sometimes served without the packed script, only a fresh one helps */
+                    fail(Resolution::FetchPage, RequestResult{RequestResult::Transient}, "page came without the download form");
+                    break;
+                }
+                resolution.page.clear();
+                resolution.stage = Resolution::PostForm;
+                break;
             }
+            case Resolution::PostForm:
+            {
+                cpr::Response response = post_kwik_form(kwikLink, resolution);
 
-            directLink = fetch_kwik_direct(link, token, kwik_session);
-        }
-        catch (const std::exception& e)
-        {
-            return fetch_kwik_dlink(kwikLink, retries - 1);
+                // Check if status code is 302 (redirect)
+                if (response.status_code == 302)
+                {
+                    // Extract the redirect location from the response header
+                    re2::StringPiece rawHeader(response.raw_header);
+                    if (RE2::FindAndConsume(&rawHeader, Patterns::get().location, &resolution.location))
+                    {
+                        resolution.stage = Resolution::Done;
+                        break;
+                    }
+                    fail(Resolution::FetchPage, RequestResult{RequestResult::Transient}, "redirect without a Location");
+                    break;
+                }
+
+                RequestResult result = RetryPolicy::classify(response);
+                if (result.kind == RequestResult::Transient)
+                {
+                    /* the request did not get through, the token and session still hold */
+                    fail(Resolution::PostForm, result, fmt::format("POST failed, StatusCode: {}", response.status_code));
+                }
+                else
+                {
+                    /* 419 and the like, or the page again: the token is spent or the session expired */
+                    fail(Resolution::FetchPage, RequestResult{RequestResult::Transient}, fmt::format("token refused, StatusCode: {}", response.status_code));
+                }
+                break;
+            }
+            case Resolution::Done:
+                break;
+            }
         }
 
-        return directLink;
+        return resolution.location;
     }
 
-    std::string KwikPahe::extract_kwik_link(const std::string &link)
+    std::string KwikPahe::extract_kwik_link(const std::string &link) const
     {
-        fmt::print("\n\r * Extracting Kwik Link...");
-        cpr::Response response = cpr::Get(cpr::Url{link});
+        cpr::Response response = get(link);
         if (response.status_code != 200)
         {
             throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", link, response.status_code));
         }
         
-        std::string cleanText = response.text;
-        RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
-        cleanText = sanitize_utf8(cleanText);
-        
         std::string kwikLink;
-        
-        // First attempt: direct link extraction
-        re2::StringPiece normal_search(cleanText);
-        bool found_direct = RE2::FindAndConsume(&normal_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
-        
-        if (!found_direct || kwikLink.empty())
+        try
         {
-            // Second attempt: decode and extract
-            re2::StringPiece encode_search(cleanText);
-            std::string temp_encoded, temp_alphabet, temp_offset_str, temp_base_str;
-            
-            bool found_params = RE2::FindAndConsume(
-                &encode_search,
-                R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
-                &temp_encoded, &temp_alphabet, &temp_offset_str, &temp_base_str
-            );
-
-            if (!found_params)
-            {
-                throw std::runtime_error(fmt::format("Failed to extract encoding parameters from {}", link));
-            }
-
-            try 
-            {
-                int temp_offset = std::stoi(temp_offset_str);
-                int temp_base = std::stoi(temp_base_str);
-                
-                std::string decodedString = decodeJSStyle(temp_encoded, zp, temp_alphabet, temp_offset, temp_base, placeholder);
-                re2::StringPiece decoded_search(decodedString);
-                
-                bool found_decoded = RE2::FindAndConsume(&decoded_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
-                
-                if (!found_decoded || kwikLink.empty())
-                {
-                    throw std::runtime_error(fmt::format("Failed to extract Kwik link from decoded content"));
-                }
-                
-                RE2::Replace(&kwikLink, R"re((https:\/\/kwik\.[^\/]+\/)d\/)re", "\\1f/");
-            }
-            catch (const std::exception& e)
-            {
-                throw std::runtime_error(fmt::format("Failed to decode and extract Kwik link: {}", e.what()));
-            }
+            kwikLink = extractKwikLink(response.text);
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(fmt::format("Failed to extract Kwik link from {}: {}", link, e.what()));
         }
 
-        fmt::print("\r * Extracting Kwik Link :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n");
-        fmt::print(" * Fetching Kwik Direct Link...");
-        
-        std::string directLink = fetch_kwik_dlink(kwikLink);
-        
-        fmt::print("\r * Fetching Kwik Direct Link :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n");
-        return directLink;
+        /* progress is reported by the caller, resolution may run next to the download dashboard */
+        return fetch_kwik_dlink(kwikLink);
     }
 }
@@ -0,0 +1,265 @@
+#include "linkcache.hpp"
+#include "httpcache.hpp"
+#include <nlohmann/json.hpp>
+#include "patterns.hpp"
+#include <fmt/core.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <random>
+
+using json = nlohmann::json;
+
+static long long now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+LinkCache &LinkCache::instance()
+{
+    static LinkCache cache;
+    return cache;
+}
+
+LinkCache::LinkCache()
+{
+    std::string directory = HttpCache::defaultDirectory();
+    if (!directory.empty())
+    {
+        path_ = (std::filesystem::path(directory) / "links.json").string();
+    }
+}
+
+void LinkCache::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    enabled_ = enabled;
+}
+
+void LinkCache::load()
+{
+    /* read on first use, so --no-cache never touches the file */
+    loaded_ = true;
+    /* a damaged file is an empty cache, never a failed episode */
+    try
+    {
+        read();
+    }
+    catch (const std::exception &)
+    {
+        entries_.clear();
+        rejections_.clear();
+    }
+}
+
+void LinkCache::read()
+{
+    std::ifstream infile(path_);
+    if (path_.empty() || !infile.is_open())
+    {
+        return;
+    }
+
+    json parsed = json::parse(infile, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object())
+    {
+        return;
+    }
+    if (parsed.contains("rejections") && parsed["rejections"].is_array())
+    {
+        const long long oldest = now() - std::chrono::seconds(REJECTION_MAX_AGE).count();
+        for (const auto &value : parsed["rejections"])
+        {
+            if (!value.is_object())
+            {
+                continue;
+            }
+            Rejection rejection;
+            rejection.rejectedAt = value.value("rejectedAt", 0LL);
+            rejection.age = value.value("age", 0LL);
+            if (rejection.rejectedAt > oldest && rejection.age > 0)
+            {
+                rejections_.push_back(rejection);
+            }
+        }
+        while (rejections_.size() > REJECTION_WINDOW)
+        {
+            rejections_.pop_front();
+        }
+    }
+    if (!parsed.contains("links") || !parsed["links"].is_object())
+    {
+        return;
+    }
+    for (const auto &[source, value] : parsed["links"].items())
+    {
+        /* hand-edited or damaged entries are dropped with the next save */
+        if (!value.is_object())
+        {
+            continue;
+        }
+        Entry entry;
+        entry.link = value.value("link", "");
+        entry.resolvedAt = value.value("resolvedAt", 0LL);
+        entry.expires = value.value("expires", 0LL);
+        /* expired entries are dropped with the next save */
+        if (!entry.link.empty() && expiresAt(entry) > now())
+        {
+            entries_[source] = entry;
+        }
+    }
+}
+
+void LinkCache::save() const
+{
+    if (path_.empty())
+    {
+        return;
+    }
+
+    json links = json::object();
+    for (const auto &[source, entry] : entries_)
+    {
+        links[source] = {{"link", entry.link}, {"resolvedAt", entry.resolvedAt}, {"expires", entry.expires}};
+    }
+    json rejections = json::array();
+    for (const Rejection &rejection : rejections_)
+    {
+        rejections.push_back({{"rejectedAt", rejection.rejectedAt}, {"age", rejection.age}});
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path_).parent_path(), ec);
+    /* write aside and rename, other processes may read it meanwhile; the temp name is unique across processes */
+    thread_local std::mt19937_64 rng(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    const std::string temp = fmt::format("{}.{:016x}.tmp", path_, rng());
+    {
+        std::ofstream outfile(temp, std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            return;
+        }
+        outfile << json{{"rejections", rejections}, {"links", links}}.dump(2);
+        if (!outfile.good())
+        {
+            outfile.close();
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, path_, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+    }
+}
+
+long long LinkCache::observedLifetime() const
+{
+    /* rejections past REJECTION_MAX_AGE stop counting without waiting for the next one */
+    const long long oldest = now() - std::chrono::seconds(REJECTION_MAX_AGE).count();
+    long long lifetime = 0;
+    for (const Rejection &rejection : rejections_)
+    {
+        if (rejection.rejectedAt > oldest)
+        {
+            lifetime = lifetime > 0 ? std::min(lifetime, rejection.age) : rejection.age;
+        }
+    }
+    return lifetime;
+}
+
+long long LinkCache::expiresAt(const Entry &entry) const
+{
+    if (entry.expires > 0)
+    {
+        return entry.expires;
+    }
+    const long long observed = observedLifetime();
+    long long lifetime = observed > 0 ? observed : std::chrono::seconds(DEFAULT_LIFETIME).count();
+    return entry.resolvedAt + lifetime;
+}
+
+std::string LinkCache::lookup(const std::string &source)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!enabled_)
+    {
+        return "";
+    }
+    if (!loaded_)
+    {
+        load();
+    }
+
+    auto entry = entries_.find(source);
+    if (entry == entries_.end())
+    {
+        return "";
+    }
+    if (expiresAt(entry->second) - now() < std::chrono::seconds(MARGIN).count())
+    {
+        entries_.erase(entry);
+        save();
+        return "";
+    }
+    return entry->second.link;
+}
+
+void LinkCache::store(const std::string &source, const std::string &link)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!enabled_ || link.empty())
+    {
+        return;
+    }
+    if (!loaded_)
+    {
+        load();
+    }
+
+    Entry entry;
+    entry.link = link;
+    entry.resolvedAt = now();
+    /* signed links usually say when they stop working */
+    std::string expires;
+    if (RE2::PartialMatch(link, AnimepaheCLI::Patterns::get().linkExpires, &expires))
+    {
+        entry.expires = std::stoll(expires);
+    }
+    entries_[source] = entry;
+    save();
+}
+
+void LinkCache::reject(const std::string &source)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!enabled_)
+    {
+        return;
+    }
+    if (!loaded_)
+    {
+        load();
+    }
+
+    auto entry = entries_.find(source);
+    if (entry == entries_.end())
+    {
+        return;
+    }
+    /**
+     * Links without an expiry of their own are trusted no longer than the shortest
+     * recent one that failed. A link refused within minutes says nothing about expiry. */
+    long long age = now() - entry->second.resolvedAt;
+    if (entry->second.expires == 0 && age > std::chrono::seconds(MARGIN).count())
+    {
+        rejections_.push_back(Rejection{now(), age});
+        if (rejections_.size() > REJECTION_WINDOW)
+        {
+            rejections_.pop_front();
+        }
+    }
+    entries_.erase(entry);
+    save();
+}
@@ -0,0 +1,165 @@
+#include "manifest.hpp"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+
+using json = nlohmann::json;
+
+const char *Manifest::FILENAME = ".animepahe-manifest.json";
+
+static long long modifiedTime(const std::filesystem::path &path, std::error_code &ec)
+{
+    auto time = std::filesystem::last_write_time(path, ec);
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+Manifest::Manifest(const std::string &directory) : directory_(directory)
+{
+    std::ifstream infile(std::filesystem::path(directory_) / FILENAME);
+    if (!infile.is_open())
+    {
+        return;
+    }
+
+    json parsed = json::parse(infile, nullptr, false);
+    if (parsed.is_discarded() || !parsed.contains("files") || !parsed["files"].is_array())
+    {
+        return;
+    }
+
+    for (const auto &file : parsed["files"])
+    {
+        try
+        {
+            ManifestEntry entry;
+            entry.filename = file.at("filename").get<std::string>();
+            entry.size = file.at("size").get<size_t>();
+            entry.hash = file.value("hash", "");
+            entry.url = file.value("url", "");
+            entry.source = file.value("source", "");
+            entry.page = file.value("page", "");
+            entry.variant = file.value("variant", "");
+            entry.modified = file.value("modified", 0LL);
+            entries_[entry.filename] = entry;
+        }
+        catch (const json::exception &)
+        {
+            /* skip entries we cannot read, the file is downloaded again */
+        }
+    }
+}
+
+bool Manifest::onDisk(const ManifestEntry &entry) const
+{
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::path(directory_) / entry.filename;
+    size_t size = std::filesystem::file_size(path, ec);
+    if (ec || size != entry.size)
+    {
+        return false;
+    }
+    long long modified = modifiedTime(path, ec);
+    return !ec && modified == entry.modified;
+}
+
+bool Manifest::contains(const std::string &filename) const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto entry = entries_.find(filename);
+    return entry != entries_.end() && onDisk(entry->second);
+}
+
+bool Manifest::containsSource(const std::string &source) const
+{
+    if (source.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &[filename, entry] : entries_)
+    {
+        if (entry.source == source && onDisk(entry))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Manifest::containsPage(const std::string &page, const std::string &variant) const
+{
+    /* entries from before variants were recorded never match, fetch_episode and the source decide */
+    if (page.empty() || variant.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &[filename, entry] : entries_)
+    {
+        if (entry.page == page && entry.variant == variant && onDisk(entry))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Manifest::record(ManifestEntry entry)
+{
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::path(directory_) / entry.filename;
+    entry.size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+    entry.modified = modifiedTime(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    entries_[entry.filename] = entry;
+    return save();
+}
+
+bool Manifest::save() const
+{
+    json files = json::array();
+    for (const auto &[filename, entry] : entries_)
+    {
+        files.push_back({
+            {"filename", entry.filename},
+            {"size", entry.size},
+            {"hash", entry.hash},
+            {"url", entry.url},
+            {"source", entry.source},
+            {"page", entry.page},
+            {"variant", entry.variant},
+            {"modified", entry.modified}});
+    }
+
+    /* write aside and rename, so a crash never leaves a torn manifest */
+    const std::filesystem::path target = std::filesystem::path(directory_) / FILENAME;
+    const std::filesystem::path temp = target.string() + ".tmp";
+    {
+        std::ofstream outfile(temp, std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            return false;
+        }
+        outfile << json{{"files", files}}.dump(2);
+        if (!outfile.good())
+        {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, target, ec);
+    return !ec;
+}
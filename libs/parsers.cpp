@@ -0,0 +1,497 @@
+#include <parsers.hpp>
+#include <patterns.hpp>
+#include <htmlentities.hpp>
+#include <utils.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+namespace AnimepaheCLI
+{
+    static constexpr std::string_view ANCHOR_OPEN = R"(<a href="https://pahe.win/)";
+    static constexpr std::string_view ANCHOR_CLOSE = "</a>";
+    static constexpr std::string_view MENU_CLOSE = "</div>";
+    static constexpr std::string_view SPAN_OPEN = "<span";
+    static constexpr std::string_view SPAN_CLOSE = "</span>";
+
+    static bool isWordChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+
+    /* first standalone 3-4 digit number followed by p, "1080p" -> "1080" */
+    static std::string_view findResolution(std::string_view block)
+    {
+        size_t i = 0;
+        while (i < block.size())
+        {
+            if (!std::isdigit(static_cast<unsigned char>(block[i])))
+            {
+                ++i;
+                continue;
+            }
+            size_t start = i;
+            while (i < block.size() && std::isdigit(static_cast<unsigned char>(block[i])))
+            {
+                ++i;
+            }
+            size_t length = i - start;
+            bool boundaryBefore = start == 0 || !isWordChar(block[start - 1]);
+            bool boundaryAfter = i + 1 >= block.size() || !isWordChar(block[i + 1]);
+            if (boundaryBefore && length >= 3 && length <= 4 && i < block.size() && block[i] == 'p' && boundaryAfter)
+            {
+                return block.substr(start, length);
+            }
+        }
+        return {};
+    }
+
+    /* the site tags dubs as "dub" or by language, anything else is a language there is no option for */
+    static AudioLang spanLang(const std::string &tag)
+    {
+        if (tag == "dub" || tag == "eng")
+        {
+            return AudioLang::English;
+        }
+        if (tag == "chi" || tag == "zh")
+        {
+            return AudioLang::Chinese;
+        }
+        return tag == "jp" ? AudioLang::Japanese : AudioLang::Other;
+    }
+
+    bool PlayPageScanner::feed(std::string_view chunk)
+    {
+        if (done_)
+        {
+            return false;
+        }
+        pending_.append(chunk);
+
+        size_t pos = 0;
+        while (true)
+        {
+            size_t anchor = pending_.find(ANCHOR_OPEN, pos);
+            if (!sources_.empty())
+            {
+                size_t close = pending_.find(MENU_CLOSE, pos);
+                if (close != std::string::npos && (anchor == std::string::npos || close < anchor))
+                {
+                    done_ = true;
+                    pending_.clear();
+                    pending_.shrink_to_fit();
+                    return false;
+                }
+            }
+
+            if (anchor == std::string::npos)
+            {
+                /* keep just enough to recognise a marker split across chunks */
+                size_t keep = std::max(ANCHOR_OPEN.size(), MENU_CLOSE.size()) - 1;
+                pos = std::max(pos, pending_.size() > keep ? pending_.size() - keep : 0);
+                break;
+            }
+
+            size_t end = pending_.find(ANCHOR_CLOSE, anchor + ANCHOR_OPEN.size());
+            if (end == std::string::npos)
+            {
+                pos = anchor;
+                break;
+            }
+            end += ANCHOR_CLOSE.size();
+            parseAnchor(std::string_view(pending_).substr(anchor, end - anchor));
+            pos = end;
+        }
+
+        pending_.erase(0, pos);
+        return true;
+    }
+
+    void PlayPageScanner::parseAnchor(std::string_view anchor)
+    {
+        /* <a href="https://pahe.win/..." ...>text <span>lang</span></a> */
+        const size_t hrefStart = ANCHOR_OPEN.size() - std::string_view("https://pahe.win/").size();
+        const size_t hrefEnd = anchor.find('"', ANCHOR_OPEN.size());
+        const size_t tagEnd = hrefEnd == std::string_view::npos ? hrefEnd : anchor.find('>', hrefEnd);
+        if (tagEnd == std::string_view::npos)
+        {
+            return;
+        }
+        std::string_view href = anchor.substr(hrefStart, hrefEnd - hrefStart);
+        if (std::any_of(href.begin(), href.end(), isSpace))
+        {
+            return;
+        }
+
+        section_.append(anchor);
+        section_.push_back('\n');
+
+        /* line breaks inside the menu entry are layout only */
+        std::string block;
+        block.reserve(anchor.size() - tagEnd);
+        for (char c : anchor.substr(tagEnd + 1, anchor.size() - ANCHOR_CLOSE.size() - tagEnd - 1))
+        {
+            if (c != '\r' && c != '\n')
+            {
+                block.push_back(c);
+            }
+        }
+        std::string_view view(block);
+
+        EpisodeSource source;
+        source.link.assign(href);
+        decodeHtmlEntities(source.link, true);
+
+        for (char digit : findResolution(view))
+        {
+            source.resolution = source.resolution * 10 + (digit - '0');
+        }
+
+        /* the first span that is not the Blu-ray tag names the audio language */
+        size_t span = view.find(SPAN_OPEN);
+        while (span != std::string_view::npos)
+        {
+            size_t open = view.find('>', span);
+            size_t text = open == std::string_view::npos ? open : open + 1;
+            size_t close = text == std::string_view::npos ? text : view.find('<', text);
+            if (close == std::string_view::npos)
+            {
+                break;
+            }
+            if (view.substr(close, SPAN_CLOSE.size()) != SPAN_CLOSE)
+            {
+                span = view.find(SPAN_OPEN, span + 1);
+                continue;
+            }
+
+            std::string spanContent(view.substr(text, close - text));
+            std::transform(spanContent.begin(), spanContent.end(), spanContent.begin(), ::tolower);
+            if (spanContent == "bd")
+            {
+                source.bluray = true;
+                span = view.find(SPAN_OPEN, close + SPAN_CLOSE.size());
+                continue;
+            }
+            source.lang = spanLang(spanContent);
+            break;
+        }
+
+        sources_.push_back(std::move(source));
+    }
+
+    std::vector<EpisodeSource> parsePlayPage(std::string_view html)
+    {
+        PlayPageScanner scanner;
+        scanner.feed(html);
+        return scanner.sources();
+    }
+
+    /* json_sax handler behind parseReleasePage, tracks only how deep it is and which field it is in */
+    class ReleasePageHandler
+    {
+    public:
+        using json = nlohmann::json;
+
+        explicit ReleasePageHandler(ReleasePage &page) : page_(page) {}
+
+        bool null() { return true; }
+        bool boolean(bool) { return true; }
+        bool number_integer(json::number_integer_t value) { return count(value); }
+        bool number_unsigned(json::number_unsigned_t value) { return count(static_cast<long long>(std::min<json::number_unsigned_t>(value, std::numeric_limits<int>::max()))); }
+        bool number_float(json::number_float_t, const json::string_t &) { return true; }
+        bool binary(json::binary_t &) { return true; }
+
+        bool string(json::string_t &value)
+        {
+            if (depth_ == EPISODE_DEPTH && inData_ && inSession_)
+            {
+                page_.sessions.back() = std::move(value);
+            }
+            return true;
+        }
+
+        bool key(json::string_t &name)
+        {
+            if (depth_ == 1)
+            {
+                field_ = name == "total" ? Field::Total
+                       : name == "per_page" ? Field::PerPage
+                       : name == "last_page" ? Field::LastPage
+                       : name == "data" ? Field::Data
+                       : Field::Other;
+            }
+            else if (depth_ == EPISODE_DEPTH)
+            {
+                inSession_ = name == "session";
+            }
+            return true;
+        }
+
+        bool start_object(std::size_t)
+        {
+            if (depth_ == EPISODE_DEPTH - 1 && inData_)
+            {
+                /* one slot per entry, so positions still match episode numbers */
+                page_.sessions.emplace_back();
+            }
+            ++depth_;
+            inSession_ = false;
+            return true;
+        }
+
+        bool end_object()
+        {
+            --depth_;
+            return true;
+        }
+
+        bool start_array(std::size_t)
+        {
+            if (depth_ == 1 && field_ == Field::Data)
+            {
+                inData_ = true;
+            }
+            ++depth_;
+            return true;
+        }
+
+        bool end_array()
+        {
+            --depth_;
+            if (depth_ == 1)
+            {
+                inData_ = false;
+            }
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &)
+        {
+            return false;
+        }
+
+    private:
+        /* top-level object, data array, entry object */
+        static const int EPISODE_DEPTH = 3;
+
+        enum class Field
+        {
+            Other,
+            Total,
+            PerPage,
+            LastPage,
+            Data
+        };
+
+        ReleasePage &page_;
+        int depth_ = 0;
+        Field field_ = Field::Other;
+        bool inData_ = false;
+        bool inSession_ = false;
+
+        bool count(long long value)
+        {
+            if (depth_ != 1 || value < 0)
+            {
+                return true;
+            }
+            int number = static_cast<int>(std::min<long long>(value, std::numeric_limits<int>::max()));
+            switch (field_)
+            {
+            case Field::Total:
+                page_.total = number;
+                break;
+            case Field::PerPage:
+                page_.perPage = number;
+                break;
+            case Field::LastPage:
+                page_.lastPage = number;
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+    };
+
+    bool parseReleasePage(std::string_view payload, ReleasePage &page)
+    {
+        ReleasePageHandler handler(page);
+        return nlohmann::json::sax_parse(payload.begin(), payload.end(), &handler);
+    }
+
+    std::string decodePackedScript(std::string_view encoded, std::string_view alphabet, int offset, int base)
+    {
+        /* digits of the number base, in the order the site's script uses */
+        static constexpr std::string_view DIGITS = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/";
+        const std::string_view digits = DIGITS.substr(0, static_cast<size_t>(std::max(0, base)));
+        std::array<int, 256> digitValue;
+        digitValue.fill(0); /* anything else still takes a digit position, worth nothing */
+        for (size_t d = 0; d < digits.size(); ++d)
+        {
+            digitValue[static_cast<unsigned char>(digits[d])] = static_cast<int>(d);
+        }
+
+        std::array<bool, 256> rewritten{};
+        for (char symbol : alphabet)
+        {
+            rewritten[static_cast<unsigned char>(symbol)] = true;
+        }
+        for (char digit = '0'; digit <= '9'; ++digit)
+        {
+            rewritten[static_cast<unsigned char>(digit)] = true;
+        }
+
+        /**
+         * What each byte contributes to a token's value: the script replaces
+         * every symbol by its index, one symbol after the other in alphabet
+         * order, so a byte may become several digits, and digits written for
+         * one symbol may be replaced again by a later one. Worked out once per
+         * byte, a token is then read as value = value * scale + digits. */
+        struct Step
+        {
+            long long scale = 0;
+            long long value = 0;
+        };
+        std::array<Step, 256> steps;
+        for (int c = 0; c < 256; ++c)
+        {
+            if (!rewritten[c])
+            {
+                steps[c] = Step{base, digitValue[c]};
+                continue;
+            }
+
+            std::string expansion(1, static_cast<char>(c));
+            for (size_t j = 0; j < alphabet.size(); ++j)
+            {
+                if (expansion.find(alphabet[j]) == std::string::npos)
+                {
+                    continue;
+                }
+                const std::string index = std::to_string(j);
+                std::string replaced;
+                for (char e : expansion)
+                {
+                    replaced += e == alphabet[j] ? index : std::string(1, e);
+                }
+                expansion = std::move(replaced);
+            }
+
+            Step step{1, 0};
+            for (char e : expansion)
+            {
+                step.scale *= base;
+                step.value = step.value * base + digitValue[static_cast<unsigned char>(e)];
+            }
+            steps[c] = step;
+        }
+
+        /* past the end of the alphabet the script compares against the string's terminator */
+        const char delimiter = base >= 0 && static_cast<size_t>(base) < alphabet.size() ? alphabet[base] : '\0';
+        std::string decoded;
+        decoded.reserve(std::count(encoded.begin(), encoded.end(), delimiter) + 1);
+
+        size_t i = 0;
+        while (i < encoded.size())
+        {
+            long long value = 0;
+            for (; i < encoded.size() && encoded[i] != delimiter; ++i)
+            {
+                const Step &step = steps[static_cast<unsigned char>(encoded[i])];
+                value = value * step.scale + step.value;
+            }
+            /* the script turns an empty token into the character '0', not the number */
+            const int code = value == 0 ? '0' : static_cast<int>(value);
+            decoded.push_back(static_cast<char>(code - offset));
+            ++i; /* past the delimiter */
+        }
+        return decoded;
+    }
+
+    bool findPackedScript(const std::string &text, PackedScript &script)
+    {
+        re2::StringPiece encode_search(text);
+        std::string offsetStr, baseStr;
+        if (!RE2::FindAndConsume(
+                &encode_search,
+                Patterns::get().packedScript,
+                &script.encoded, &script.alphabet, &offsetStr, &baseStr))
+        {
+            return false;
+        }
+        try
+        {
+            script.offset = std::stoi(offsetStr);
+            script.base = std::stoi(baseStr);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    std::string extractKwikLink(const std::string &html)
+    {
+        std::string cleanText = html;
+        RE2::GlobalReplace(&cleanText, Patterns::get().newline, "");
+        cleanText = sanitize_utf8(std::move(cleanText));
+
+        std::string kwikLink;
+
+        // First attempt: direct link extraction
+        re2::StringPiece normal_search(cleanText);
+        if (RE2::FindAndConsume(&normal_search, Patterns::get().kwikLink, &kwikLink) && !kwikLink.empty())
+        {
+            return kwikLink;
+        }
+
+        // Second attempt: decode and extract
+        PackedScript script;
+        if (!findPackedScript(cleanText, script))
+        {
+            throw std::runtime_error("no encoding parameters found");
+        }
+
+        std::string decodedString = decodePackedScript(script.encoded, script.alphabet, script.offset, script.base);
+        re2::StringPiece decoded_search(decodedString);
+        if (!RE2::FindAndConsume(&decoded_search, Patterns::get().kwikLink, &kwikLink) || kwikLink.empty())
+        {
+            throw std::runtime_error("no Kwik link in decoded content");
+        }
+
+        RE2::Replace(&kwikLink, Patterns::get().kwikDownloadPath, "\\1f/");
+        return kwikLink;
+    }
+
+    bool extractKwikForm(const std::string &html, std::string &action, std::string &token)
+    {
+        std::string cleanText = html;
+        RE2::GlobalReplace(&cleanText, Patterns::get().newline, "");
+
+        PackedScript script;
+        if (!findPackedScript(cleanText, script) || script.encoded.empty() || script.alphabet.empty())
+        {
+            return false;
+        }
+
+        std::string decodedString = decodePackedScript(script.encoded, script.alphabet, script.offset, script.base);
+
+        // Use fresh StringPiece objects for each search
+        re2::StringPiece link_search(decodedString);
+        re2::StringPiece token_search(decodedString);
+
+        bool found_link = RE2::FindAndConsume(&link_search, Patterns::get().kwikLink, &action);
+        bool found_token = RE2::FindAndConsume(&token_search, Patterns::get().formToken, &token);
+        return found_link && found_token && !action.empty() && !token.empty();
+    }
+}
@@ -0,0 +1,188 @@
+#include "partfile.hpp"
+#include "checksum.hpp"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+std::string PartFile::partPath(const std::string &filepath)
+{
+    return filepath + ".part";
+}
+
+std::string PartFile::metaPath(const std::string &filepath)
+{
+    return filepath + ".part.meta";
+}
+
+bool PartFile::load(const std::string &filepath)
+{
+    std::ifstream infile(metaPath(filepath));
+    if (!infile.is_open())
+    {
+        return false;
+    }
+
+    json parsed = json::parse(infile, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object())
+    {
+        return false;
+    }
+
+    try
+    {
+        url = parsed.value("url", "");
+        etag = parsed.value("etag", "");
+        lastModified = parsed.value("lastModified", "");
+        totalSize = parsed.value("totalSize", size_t{0});
+        bytesWritten = parsed.value("bytesWritten", size_t{0});
+        checksum = parsed.value("checksum", uint64_t{0});
+        checksummed = parsed.contains("checksum");
+        segments.clear();
+
+        if (parsed.contains("segments") && parsed["segments"].is_array())
+        {
+            for (const auto &segment : parsed["segments"])
+            {
+                /* [begin, end, checksum], older sidecars have no checksum */
+                checksummed = checksummed && segment.size() > 2;
+                segments.push_back(Segment{segment.at(0).get<size_t>(), segment.at(1).get<size_t>(),
+                                           segment.size() > 2 ? segment.at(2).get<uint64_t>() : 0});
+            }
+        }
+    }
+    catch (const json::exception &)
+    {
+        /* a sidecar we cannot read is treated as missing */
+        return false;
+    }
+    return true;
+}
+
+bool PartFile::save(const std::string &filepath) const
+{
+    json ranges = json::array();
+    for (const auto &segment : segments)
+    {
+        ranges.push_back({segment.begin, segment.end, segment.checksum});
+    }
+
+    json sidecar = {
+        {"url", url},
+        {"etag", etag},
+        {"lastModified", lastModified},
+        {"totalSize", totalSize},
+        {"bytesWritten", bytesWritten},
+        {"segments", ranges}};
+    /* a missing checksum marks bytes of unknown origin, so later runs do not trust a made-up one */
+    if (checksummed)
+    {
+        sidecar["checksum"] = checksum;
+    }
+
+    /* write aside and rename, so a crash never leaves a torn sidecar */
+    const std::string target = metaPath(filepath);
+    const std::string temp = target + ".tmp";
+    {
+        std::ofstream outfile(temp, std::ios::trunc);
+        if (!outfile.is_open())
+        {
+            return false;
+        }
+        outfile << sidecar.dump();
+        if (!outfile.good())
+        {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, target, ec);
+    return !ec;
+}
+
+std::string PartFile::validator() const
+{
+    return etag.empty() ? lastModified : etag;
+}
+
+void PartFile::addSegment(size_t begin, size_t end, uint64_t crc)
+{
+    segments.push_back(Segment{begin, end, crc});
+    std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b)
+    {
+        return a.begin < b.begin;
+    });
+
+    /* merge overlapping and adjacent ranges, adjacent checksums combine exactly */
+    std::vector<Segment> merged;
+    for (const auto &segment : segments)
+    {
+        if (!merged.empty() && segment.begin == merged.back().end + 1)
+        {
+            merged.back().checksum = Crc64::combine(merged.back().checksum, segment.checksum, segment.end - segment.begin + 1);
+            merged.back().end = segment.end;
+        }
+        else if (!merged.empty() && segment.begin <= merged.back().end)
+        {
+            /* overlapping bytes were written twice, the sum of both checksums means nothing */
+            checksummed = false;
+            merged.back().end = std::max(merged.back().end, segment.end);
+        }
+        else
+        {
+            merged.push_back(segment);
+        }
+    }
+    segments = std::move(merged);
+}
+
+std::vector<std::pair<size_t, size_t>> PartFile::missingSegments() const
+{
+    std::vector<std::pair<size_t, size_t>> missing;
+    size_t cursor = 0;
+    for (const auto &segment : segments)
+    {
+        if (segment.begin > cursor)
+        {
+            missing.emplace_back(cursor, segment.begin - 1);
+        }
+        cursor = std::max(cursor, segment.end + 1);
+    }
+    if (cursor < totalSize)
+    {
+        missing.emplace_back(cursor, totalSize - 1);
+    }
+    return missing;
+}
+
+size_t PartFile::segmentBytes() const
+{
+    size_t bytes = 0;
+    for (const auto &segment : segments)
+    {
+        bytes += segment.end - segment.begin + 1;
+    }
+    return bytes;
+}
+
+bool PartFile::complete(const std::string &filepath)
+{
+    std::error_code ec;
+    std::filesystem::rename(partPath(filepath), filepath, ec);
+    if (ec)
+    {
+        return false;
+    }
+    std::filesystem::remove(metaPath(filepath), ec);
+    return true;
+}
+
+void PartFile::discard(const std::string &filepath)
+{
+    std::error_code ec;
+    std::filesystem::remove(partPath(filepath), ec);
+    std::filesystem::remove(metaPath(filepath), ec);
+}
@@ -0,0 +1,208 @@
+#include "progress.hpp"
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+std::string formatTime(double totalSeconds)
+{
+    int seconds = static_cast<int>(std::round(totalSeconds)); /* Round to nearest second */
+    return fmt::format("{:02}:{:02}:{:02}", seconds / 3600, (seconds % 3600) / 60, seconds % 60);
+}
+
+std::string formatSpeedMB(double bytesPerSecond)
+{
+    return fmt::format("{:4.2f} MB/s", bytesPerSecond / (1024.0 * 1024.0));
+}
+
+std::string formatSizeMB(size_t bytes)
+{
+    return fmt::format("{:.2f}MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+}
+
+void ProgressBoard::Meter::update(size_t now, double seconds)
+{
+    /* counters can step back when a failed range is given up */
+    double instant = now > last ? (now - last) / seconds : 0.0;
+    last = now;
+
+    if (!primed)
+    {
+        rate = instant;
+        primed = true;
+        return;
+    }
+    double alpha = 1.0 - std::exp(-seconds / SMOOTHING);
+    rate += alpha * (instant - rate);
+}
+
+ProgressBoard::~ProgressBoard()
+{
+    stop();
+}
+
+void ProgressBoard::start()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_)
+    {
+        return;
+    }
+    running_ = true;
+    lastFrame_ = std::chrono::steady_clock::now();
+    baseReceived_ = received;
+    total_ = Meter{baseReceived_, 0.0, false};
+    thread_ = std::thread(&ProgressBoard::run, this);
+}
+
+void ProgressBoard::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    clear();
+    std::fflush(stdout);
+}
+
+std::shared_ptr<ProgressSlot> ProgressBoard::add(const std::string &label, size_t total, size_t done)
+{
+    auto slot = std::make_shared<ProgressSlot>();
+    slot->label = label.size() > LABEL_WIDTH ? label.substr(0, LABEL_WIDTH - 3) + "..." : label;
+    slot->total = total;
+    slot->done = done;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    entries_.push_back(Entry{slot, Meter{done, 0.0, false}});
+    return slot;
+}
+
+void ProgressBoard::log(const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    clear();
+    fmt::print("\n{}", message);
+    if (!running_)
+    {
+        std::fflush(stdout);
+        return;
+    }
+    /* put the dashboard back right away instead of waiting for the next frame */
+    render();
+}
+
+void ProgressBoard::setJobs(size_t jobs)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    jobs_ = jobs;
+    finished_ = 0;
+}
+
+void ProgressBoard::addJob()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    jobs_++;
+}
+
+void ProgressBoard::jobFinished()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    finished_++;
+}
+
+void ProgressBoard::run()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (running_)
+    {
+        cv_.wait_for(lock, FRAME_INTERVAL);
+        if (!running_)
+        {
+            break;
+        }
+
+        /* meters advance once per frame, log() only redraws */
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - lastFrame_).count();
+        if (seconds <= 0.0)
+        {
+            continue;
+        }
+        lastFrame_ = now;
+        for (auto &entry : entries_)
+        {
+            if (auto slot = entry.slot.lock())
+            {
+                entry.meter.update(slot->done, seconds);
+            }
+        }
+        total_.update(received, seconds);
+
+        clear();
+        render();
+    }
+}
+
+void ProgressBoard::render()
+{
+    /* drop transfers that have finished */
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [](const Entry &entry)
+    {
+        return entry.slot.expired();
+    }), entries_.end());
+
+    std::string frame;
+    for (const auto &entry : entries_)
+    {
+        auto slot = entry.slot.lock();
+        if (!slot)
+        {
+            continue;
+        }
+        size_t done = slot->done;
+        size_t total = slot->total;
+        double rate = entry.meter.rate;
+
+        frame += fmt::format("\n * {} :", slot->label);
+        if (total > 0)
+        {
+            double percent = std::min(100.0, done * 100.0 / total);
+            std::string eta = rate > 0.0 ? formatTime((total - std::min(done, total)) / rate) : "--:--:--";
+            frame += fmt::format(" {:.2f}% ETA: {} | {} | [{}/{}]", percent, eta, formatSpeedMB(rate), formatSizeMB(done), formatSizeMB(total));
+        }
+        else
+        {
+            frame += fmt::format(" {} | [{}]", formatSpeedMB(rate), formatSizeMB(done));
+        }
+    }
+
+    if (jobs_ > 1)
+    {
+        frame += fmt::format("\n * Active: {} | Done: {}/{} | {} | [{}]",
+                             entries_.size(), finished_, jobs_, formatSpeedMB(total_.rate), formatSizeMB(total_.last - baseReceived_));
+    }
+
+    drawn_ = static_cast<size_t>(std::count(frame.begin(), frame.end(), '\n'));
+    std::fwrite(frame.data(), 1, frame.size(), stdout);
+    std::fflush(stdout);
+}
+
+void ProgressBoard::clear()
+{
+    /* each dashboard line was opened with a newline, walk back up to the last logged line */
+    std::string erase;
+    for (size_t i = 0; i < drawn_; ++i)
+    {
+        erase += "\r\x1b[2K\x1b[1A";
+    }
+    std::fwrite(erase.data(), 1, erase.size(), stdout);
+    drawn_ = 0;
+}
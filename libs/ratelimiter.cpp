@@ -0,0 +1,117 @@
+#include "ratelimiter.hpp"
+#include <algorithm>
+#include <ctime>
+
+RateLimiter &RateLimiter::instance()
+{
+    static RateLimiter limiter;
+    return limiter;
+}
+
+void RateLimiter::setLimit(size_t bytesPerSecond)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    baseLimit_ = bytesPerSecond;
+    /* pick up the new value on the next refill */
+    nextScheduleCheck_ = {};
+    enabled_ = baseLimit_ > 0 || !schedule_.empty();
+}
+
+void RateLimiter::setSchedule(const std::vector<RateWindow> &windows)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    schedule_ = windows;
+    nextScheduleCheck_ = {};
+    enabled_ = baseLimit_ > 0 || !schedule_.empty();
+}
+
+size_t RateLimiter::limit()
+{
+    if (!enabled_)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    refill();
+    return current_;
+}
+
+bool RateLimiter::acquire(size_t bytes)
+{
+    if (!enabled_)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    refill();
+    if (current_ == 0)
+    {
+        return true;
+    }
+    if (tokens_ <= 0.0)
+    {
+        return false;
+    }
+    tokens_ -= static_cast<double>(bytes);
+    return true;
+}
+
+bool RateLimiter::ready()
+{
+    if (!enabled_)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    refill();
+    return current_ == 0 || tokens_ > 0.0;
+}
+
+void RateLimiter::refill()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    /* the schedule only needs a look once per second */
+    if (now >= nextScheduleCheck_)
+    {
+        size_t limit = baseLimit_;
+        if (!schedule_.empty())
+        {
+            std::time_t wall = std::time(nullptr);
+            std::tm *local = std::localtime(&wall);
+            int minute = local->tm_hour * 60 + local->tm_min;
+
+            for (const auto &window : schedule_)
+            {
+                bool inside = window.begin < window.end
+                    ? minute >= window.begin && minute < window.end
+                    : minute >= window.begin || minute < window.end;
+                if (inside)
+                {
+                    limit = window.bytesPerSecond;
+                    break;
+                }
+            }
+        }
+
+        if (limit != current_)
+        {
+            /* start the new limit with an empty bucket, old debt is forgiven */
+            current_ = limit;
+            tokens_ = 0.0;
+            lastRefill_ = now;
+        }
+        nextScheduleCheck_ = now + std::chrono::seconds(1);
+    }
+
+    if (current_ == 0)
+    {
+        return;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - lastRefill_).count();
+    lastRefill_ = now;
+    tokens_ = std::min(tokens_ + elapsed * current_, current_ * BURST_SECONDS);
+}
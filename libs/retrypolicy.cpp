@@ -0,0 +1,193 @@
+#include "retrypolicy.hpp"
+#include "sessionpool.hpp"
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+/* a Retry-After beyond this is treated as a failure for this run */
+static const std::chrono::milliseconds MAX_RETRY_AFTER = std::chrono::minutes(5);
+
+Backoff::Backoff(std::chrono::milliseconds base, std::chrono::milliseconds cap)
+    : base_(base), cap_(cap), previous_(base) {}
+
+std::chrono::milliseconds Backoff::next(const RequestResult &result)
+{
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+
+    auto upper = std::max(base_, previous_ * 3);
+    std::uniform_int_distribution<long long> pick(base_.count(), upper.count());
+    auto delay = std::min(cap_, std::chrono::milliseconds(pick(rng)));
+    previous_ = delay;
+
+    if (result.retryAfter > delay)
+    {
+        delay = std::min(result.retryAfter, MAX_RETRY_AFTER);
+    }
+    return delay;
+}
+
+RetryPolicy &RetryPolicy::instance()
+{
+    static RetryPolicy policy;
+    return policy;
+}
+
+RequestResult RetryPolicy::classify(const cpr::Response &response)
+{
+    auto retryAfter = response.header.find("retry-after");
+    return classify(response.status_code, response.error, retryAfter == response.header.end() ? "" : retryAfter->second);
+}
+
+RequestResult RetryPolicy::classify(long status, const cpr::Error &error, const std::string &retryAfter)
+{
+    RequestResult result;
+    result.status = status;
+
+    /* an HTTP status says more than the transport error of an aborted body */
+    if (status >= 400)
+    {
+        bool transient = status == 408 || status == 425 || status == 429 || (status >= 500 && status != 501 && status != 505);
+        result.kind = transient ? RequestResult::Transient : RequestResult::Permanent;
+
+        if (transient && !retryAfter.empty())
+        {
+            /* delta-seconds or an HTTP date */
+            char *end = nullptr;
+            long seconds = std::strtol(retryAfter.c_str(), &end, 10);
+            if (end == retryAfter.c_str())
+            {
+                time_t when = curl_getdate(retryAfter.c_str(), nullptr);
+                seconds = when > 0 ? static_cast<long>(when - std::time(nullptr)) : 0;
+            }
+            result.retryAfter = std::chrono::seconds(std::max(0L, seconds));
+            if (result.retryAfter > MAX_RETRY_AFTER)
+            {
+                result.kind = RequestResult::Permanent;
+            }
+        }
+        return result;
+    }
+
+    switch (error.code)
+    {
+    case cpr::ErrorCode::OK:
+        result.kind = RequestResult::Success;
+        break;
+    case cpr::ErrorCode::INVALID_URL_FORMAT:
+    case cpr::ErrorCode::UNSUPPORTED_PROTOCOL:
+    case cpr::ErrorCode::TOO_MANY_REDIRECTS:
+    case cpr::ErrorCode::SSL_LOCAL_CERTIFICATE_ERROR:
+    case cpr::ErrorCode::SSL_REMOTE_CERTIFICATE_ERROR:
+    case cpr::ErrorCode::SSL_CACERT_ERROR:
+        result.kind = RequestResult::Permanent;
+        break;
+    default:
+        /* timeouts, resets, DNS hiccups and bodies cut short */
+        result.kind = RequestResult::Transient;
+        break;
+    }
+    return result;
+}
+
+bool RetryPolicy::allow(const std::string &url, std::chrono::steady_clock::time_point *retryAt)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mtx_);
+    Breaker &breaker = breakers_[originOf(url)];
+
+    if (breaker.state == Breaker::Open && now >= breaker.openUntil)
+    {
+        breaker.state = Breaker::HalfOpen;
+        breaker.probing = false;
+    }
+
+    switch (breaker.state)
+    {
+    case Breaker::Closed:
+        return true;
+    case Breaker::HalfOpen:
+        if (!breaker.probing)
+        {
+            breaker.probing = true;
+            return true;
+        }
+        /* wait for the probe's verdict */
+        if (retryAt)
+        {
+            *retryAt = now + std::chrono::seconds(1);
+        }
+        return false;
+    case Breaker::Open:
+    default:
+        if (retryAt)
+        {
+            *retryAt = breaker.openUntil;
+        }
+        return false;
+    }
+}
+
+void RetryPolicy::record(const std::string &url, const RequestResult &result)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    Breaker &breaker = breakers_[originOf(url)];
+
+    if (result.kind == RequestResult::Success)
+    {
+        breaker = Breaker{};
+        return;
+    }
+    if (result.kind == RequestResult::Permanent)
+    {
+        /* a missing file says nothing about the host, but a probe still has to finish */
+        if (breaker.state == Breaker::HalfOpen)
+        {
+            breaker.probing = false;
+        }
+        return;
+    }
+
+    breaker.failures++;
+    if (breaker.state == Breaker::HalfOpen)
+    {
+        /* probe failed, stay away twice as long */
+        breaker.cooldown = std::min(breaker.cooldown * 2, MAX_COOLDOWN);
+    }
+    else if (breaker.failures < FAILURE_THRESHOLD)
+    {
+        return;
+    }
+    breaker.state = Breaker::Open;
+    breaker.probing = false;
+    breaker.openUntil = std::chrono::steady_clock::now() + std::max<std::chrono::steady_clock::duration>(breaker.cooldown, result.retryAfter);
+}
+
+cpr::Response RetryPolicy::perform(const std::string &url, const std::function<cpr::Response()> &send, int attempts)
+{
+    Backoff backoff(std::chrono::milliseconds(500), std::chrono::seconds(10));
+    cpr::Response response;
+
+    for (int attempt = 0; attempt < attempts; ++attempt)
+    {
+        std::chrono::steady_clock::time_point retryAt;
+        while (!allow(url, &retryAt))
+        {
+            std::this_thread::sleep_until(retryAt);
+        }
+
+        response = send();
+        RequestResult result = classify(response);
+        record(url, result);
+        if (result.kind != RequestResult::Transient)
+        {
+            break;
+        }
+        if (attempt + 1 < attempts)
+        {
+            std::this_thread::sleep_for(backoff.next(result));
+        }
+    }
+    return response;
+}
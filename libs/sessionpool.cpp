@@ -0,0 +1,158 @@
+#include "sessionpool.hpp"
+#include <array>
+
+/**
+ * One curl share handle, with a lock per kind of shared data.
+ * Connections are not shared: handles run at once on many threads, which libcurl
+ * does not support for a shared connection cache. Each pooled handle keeps its own. */
+struct SessionPool::Share
+{
+    CURLSH *handle = curl_share_init();
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> locks;
+
+    explicit Share(bool cookies)
+    {
+        curl_share_setopt(handle, CURLSHOPT_LOCKFUNC, lock);
+        curl_share_setopt(handle, CURLSHOPT_UNLOCKFUNC, unlock);
+        curl_share_setopt(handle, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        if (cookies)
+        {
+            curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+        }
+    }
+
+    ~Share()
+    {
+        curl_share_cleanup(handle);
+    }
+
+    static void lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr)
+    {
+        static_cast<Share *>(userptr)->locks[data].lock();
+    }
+
+    static void unlock(CURL *, curl_lock_data data, void *userptr)
+    {
+        static_cast<Share *>(userptr)->locks[data].unlock();
+    }
+};
+
+std::string originOf(const std::string &url)
+{
+    size_t scheme = url.find("://");
+    size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+    size_t end = url.find_first_of("/?#", start);
+    return url.substr(0, end);
+}
+
+SessionPool::Lease::Lease(SessionPool *pool, std::string key, std::unique_ptr<cpr::Session> session)
+    : pool_(pool), key_(std::move(key)), session_(std::move(session)) {}
+
+SessionPool::Lease::Lease(Lease &&other) noexcept
+    : pool_(other.pool_), key_(std::move(other.key_)), session_(std::move(other.session_)) {}
+
+SessionPool::Lease::~Lease()
+{
+    if (session_)
+    {
+        pool_->release(key_, std::move(session_));
+    }
+}
+
+SessionPool &SessionPool::instance()
+{
+    static SessionPool pool;
+    return pool;
+}
+
+SessionPool::SessionPool() : shared_(std::make_unique<Share>(false)), browse_(std::make_unique<Share>(true)) {}
+
+SessionPool::~SessionPool()
+{
+    /* sessions must let go of the share handles before those are cleaned up */
+    idle_.clear();
+}
+
+SessionPool::Lease SessionPool::acquire(const std::string &url, SessionKind kind)
+{
+    std::string key = std::to_string(static_cast<int>(kind)) + " " + originOf(url);
+    std::unique_ptr<cpr::Session> session;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto &sessions = idle_[key];
+        if (!sessions.empty())
+        {
+            session = std::move(sessions.back());
+            sessions.pop_back();
+        }
+    }
+
+    CURL *handle;
+    if (!session)
+    {
+        session = std::make_unique<cpr::Session>();
+        handle = session->GetCurlHolder()->handle;
+        if (kind == SessionKind::Browse)
+        {
+            /* enable the cookie engine, the jar itself lives in the share */
+            curl_easy_setopt(handle, CURLOPT_COOKIEFILE, "");
+            curl_easy_setopt(handle, CURLOPT_SHARE, browse_->handle);
+        }
+        else
+        {
+            curl_easy_setopt(handle, CURLOPT_SHARE, shared_->handle);
+        }
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    }
+    else
+    {
+        /**
+         * A reused session still holds what its last user set. Put it back to
+         * cpr's defaults, so a lease never sends someone else's cookies or
+         * headers, and a write callback that outlived its capture is never called. */
+        session->SetHeader(cpr::Header{});
+        session->SetRedirect(cpr::Redirect{});
+        session->SetHttpVersion(cpr::HttpVersion{});
+        session->SetWriteCallback(cpr::WriteCallback{});
+        if (kind == SessionKind::Form)
+        {
+            /* cpr has no way back to a bodiless request, Form sessions only ever POST */
+            session->SetPayload(cpr::Payload{});
+        }
+        curl_easy_setopt(session->GetCurlHolder()->handle, CURLOPT_COOKIE, nullptr);
+    }
+    handle = session->GetCurlHolder()->handle;
+
+    if (kind != SessionKind::Browse)
+    {
+        /* same as a one-off request, no cookies left over from the last use */
+        curl_easy_setopt(handle, CURLOPT_COOKIELIST, "ALL");
+    }
+    return Lease(this, std::move(key), std::move(session));
+}
+
+void SessionPool::attach(cpr::Session &session)
+{
+    CURL *handle = session.GetCurlHolder()->handle;
+    curl_easy_setopt(handle, CURLOPT_SHARE, shared_->handle);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+}
+
+void SessionPool::release(const std::string &key, std::unique_ptr<cpr::Session> session)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &sessions = idle_[key];
+    if (sessions.size() < MAX_IDLE)
+    {
+        sessions.push_back(std::move(session));
+    }
+}
+
+void setRequestCookies(cpr::Session &session, const cpr::Cookies &cookies)
+{
+    /* cpr's SetCookies empties the jar first, which would wipe the shared one */
+    auto holder = session.GetCurlHolder();
+    curl_easy_setopt(holder->handle, CURLOPT_COOKIE, cookies.GetEncoded(*holder).c_str());
+}
@@ -1,14 +1,25 @@
+#include <utils.hpp>
+#include "ratelimiter.hpp"
 #include <re2/re2.h>
-#include <pugixml.hpp>
 #include <set>
 #include <sstream>
 #include <iomanip>
-#include <iostream>
 #include <algorithm>
 #include <string_view>
 #include <string>
 #include <regex>
 #include <unordered_set>
+#include <stdexcept>
+#include <cctype>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 namespace AnimepaheCLI
 {
@@ -50,9 +61,10 @@ namespace AnimepaheCLI
         return name;
     }
 
-    int getPage(int number)
+    int getPage(int number, int perPage)
     {
-        return std::max(1, (number + 29) / 30);
+        perPage = std::max(1, perPage);
+        return std::max(1, (number + perPage - 1) / perPage);
     }
 
     bool isValidTxtFilename(const std::string& filename) {
@@ -68,10 +80,10 @@ namespace AnimepaheCLI
         return RE2::FullMatch(filename, pattern);
     }
 
-    std::vector<int> getPaginationRange(int start, int end)
+    std::vector<int> getPaginationRange(int start, int end, int perPage)
     {
-        int start_page = getPage(start);
-        int end_page = getPage(end);
+        int start_page = getPage(start, perPage);
+        int end_page = getPage(end, perPage);
         std::vector<int> pages;
 
         for (int i = start_page; i <= end_page; ++i)
@@ -82,52 +94,168 @@ namespace AnimepaheCLI
         return pages;
     }
 
-    std::string sanitize_utf8(const std::string &input)
+    /* bytes of the complete sequence starting at data, 0 when data[0] cannot start one */
+    static size_t utf8SequenceLength(const unsigned char *data, size_t len)
     {
-        std::string output;
-        output.reserve(input.size());
-
-        const unsigned char *data = reinterpret_cast<const unsigned char *>(input.data());
-        size_t len = input.size();
+        unsigned char byte = data[0];
+        if (byte <= 0x7F)
+        {
+            return 1;
+        }
+        size_t length = (byte >> 5) == 0x6 ? 2 : (byte >> 4) == 0xE ? 3 : (byte >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || length > len)
+        {
+            return 0;
+        }
+        for (size_t i = 1; i < length; ++i)
+        {
+            if ((data[i] & 0xC0) != 0x80)
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
 
-        for (size_t i = 0; i < len;)
+    /* length of the ASCII run data starts with, a word at a time */
+    static size_t asciiRunScalar(const unsigned char *data, size_t len)
+    {
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            if (word & 0x8080808080808080ULL)
+            {
+                break;
+            }
+        }
+        while (i < len && data[i] <= 0x7F)
         {
-            unsigned char byte = data[i];
+            i++;
+        }
+        return i;
+    }
 
-            if (byte <= 0x7F)
+#if defined(__x86_64__) || defined(_M_X64)
+    /* SSE2 is part of x86-64, AVX2 is checked for at runtime */
+    static size_t asciiRunSse2(const unsigned char *data, size_t len)
+    {
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+            if (mask)
             {
-                output += byte;
-                i++;
+                return i + std::countr_zero(static_cast<unsigned>(mask));
             }
-            else if ((byte >> 5) == 0x6 && i + 1 < len &&
-                     (data[i + 1] & 0xC0) == 0x80)
+        }
+        return i + asciiRunScalar(data + i, len - i);
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((target("avx2")))
+#endif
+    static size_t asciiRunAvx2(const unsigned char *data, size_t len)
+    {
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            int mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+            if (mask)
             {
-                output.append(reinterpret_cast<const char *>(&data[i]), 2);
-                i += 2;
+                return i + std::countr_zero(static_cast<unsigned>(mask));
             }
-            else if ((byte >> 4) == 0xE && i + 2 < len &&
-                     (data[i + 1] & 0xC0) == 0x80 &&
-                     (data[i + 2] & 0xC0) == 0x80)
+        }
+        return i + asciiRunSse2(data + i, len - i);
+    }
+
+    static bool cpuHasAvx2()
+    {
+#if defined(__GNUC__)
+        return __builtin_cpu_supports("avx2");
+#else
+        /* the CPU has to have it and the OS has to save the YMM registers */
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#endif
+    }
+#endif
+
+    static size_t asciiRun(const unsigned char *data, size_t len)
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto scan = cpuHasAvx2() ? asciiRunAvx2 : asciiRunSse2;
+        return scan(data, len);
+#else
+        return asciiRunScalar(data, len);
+#endif
+    }
+
+    /* length of the valid UTF-8 data starts with: ASCII runs a block at a time, other sequences one by one */
+    static size_t validUtf8Prefix(const unsigned char *data, size_t len)
+    {
+        size_t i = 0;
+        while (true)
+        {
+            i += asciiRun(data + i, len - i);
+            /* text that is not ASCII tends to stay that way for a while */
+            while (i < len && data[i] > 0x7F)
             {
-                output.append(reinterpret_cast<const char *>(&data[i]), 3);
-                i += 3;
+                size_t length = utf8SequenceLength(data + i, len - i);
+                if (length == 0)
+                {
+                    return i;
+                }
+                i += length;
             }
-            else if ((byte >> 3) == 0x1E && i + 3 < len &&
-                     (data[i + 1] & 0xC0) == 0x80 &&
-                     (data[i + 2] & 0xC0) == 0x80 &&
-                     (data[i + 3] & 0xC0) == 0x80)
+            if (i == len)
             {
-                output.append(reinterpret_cast<const char *>(&data[i]), 4);
-                i += 4;
+                return len;
             }
-            else
+        }
+    }
+
+    std::string sanitize_utf8(std::string input)
+    {
+        unsigned char *data = reinterpret_cast<unsigned char *>(input.data());
+        size_t len = input.size();
+
+        size_t read = validUtf8Prefix(data, len);
+        if (read == len)
+        {
+            return input;
+        }
+
+        /* invalid bytes are dropped one at a time, the valid spans between them are moved down in one piece */
+        size_t write = read;
+        while (read < len)
+        {
+            if (utf8SequenceLength(data + read, len - read) == 0)
             {
                 // invalid byte, skip
-                i++;
+                read++;
+                continue;
             }
+            size_t span = validUtf8Prefix(data + read, len - read);
+            std::memmove(data + write, data + read, span);
+            write += span;
+            read += span;
         }
 
-        return output;
+        input.resize(write);
+        return input;
     }
 
     bool isFullSeriesURL(const std::string &url)
@@ -178,21 +306,88 @@ namespace AnimepaheCLI
         throw std::invalid_argument("Invalid episode range format");
     }
 
-    std::string unescape_html_entities(const std::string &input)
+    /* auto or 1-16 connections per download */
+    bool isValidConnectionsFormat(const std::string &input)
+    {
+        if (input == "auto")
+            return true;
+
+        int connections;
+        return RE2::FullMatch(input, R"((\d{1,2}))", &connections) && connections >= 1 && connections <= 16;
+    }
+
+    /* bytes per second with an optional K/M/G suffix (500K, 1.5M), 0 = unlimited */
+    bool isValidRateFormat(const std::string &input)
+    {
+        return RE2::FullMatch(input, R"(\d+(\.\d+)?[KkMmGg]?)");
+    }
+
+    size_t parseRate(const std::string &input)
     {
-        pugi::xml_document doc;
+        double value;
+        std::string unit;
+        if (!RE2::FullMatch(input, R"((\d+(?:\.\d+)?)([KkMmGg]?))", &value, &unit))
+        {
+            throw std::invalid_argument("Invalid rate format");
+        }
+
+        switch (unit.empty() ? 0 : std::toupper(static_cast<unsigned char>(unit[0])))
+        {
+        case 'G':
+            value *= 1024.0;
+            [[fallthrough]];
+        case 'M':
+            value *= 1024.0;
+            [[fallthrough]];
+        case 'K':
+            value *= 1024.0;
+        }
+        return static_cast<size_t>(value);
+    }
 
-        // Wrap string in dummy XML structure
-        std::string xml = "<root>" + input + "</root>";
-        pugi::xml_parse_result result = doc.load_string(xml.c_str());
+    /* comma separated HH:MM-HH:MM=RATE windows, e.g. 08:00-23:00=2M,23:00-08:00=0 */
+    bool isValidRateScheduleFormat(const std::string &input)
+    {
+        try
+        {
+            parseRateSchedule(input);
+            return true;
+        }
+        catch (const std::invalid_argument &)
+        {
+            return false;
+        }
+    }
 
-        if (!result)
+    /* an end of 24:00 is midnight, the window runs to the end of the day */
+    std::vector<RateWindow> parseRateSchedule(const std::string &input)
+    {
+        std::vector<RateWindow> windows;
+        std::stringstream ss(input);
+        std::string item;
+        while (std::getline(ss, item, ','))
         {
-            std::cerr << "Failed to parse XML: " << result.description() << "\n";
-            return input; // fallback to original
+            int beginHour, beginMinute, endHour, endMinute;
+            std::string rate;
+            if (!RE2::FullMatch(item, R"((\d{1,2}):(\d{2})-(\d{1,2}):(\d{2})=(\S+))", &beginHour, &beginMinute, &endHour, &endMinute, &rate) ||
+                beginHour > 23 || beginMinute > 59 || endMinute > 59 || !isValidRateFormat(rate) ||
+                (endHour > 23 && !(endHour == 24 && endMinute == 0)))
+            {
+                throw std::invalid_argument("Invalid rate schedule format");
+            }
+
+            RateWindow window;
+            window.begin = beginHour * 60 + beginMinute;
+            window.end = (endHour * 60 + endMinute) % (24 * 60);
+            window.bytesPerSecond = parseRate(rate);
+            windows.push_back(window);
         }
 
-        return doc.child("root").text().get(); // decoded text
+        if (windows.empty())
+        {
+            throw std::invalid_argument("Invalid rate schedule format");
+        }
+        return windows;
     }
 
     std::string padIntWithZero(int num)
@@ -31,6 +31,16 @@ int main(int argc, char *argv[])
      * creates a zip from downloaded items
      * --rm-source
      * remove source files after zipping
+     * -c, --connections
+     * parallel range requests per download (auto, 1-16)
+     * -p, --parallel
+     * number of episodes downloaded at the same time (1-8)
+     * --order
+     * download order (episode, largest)
+     * --limit
+     * bandwidth cap shared by all downloads (0, 500K, 2M)
+     * --limit-schedule
+     * time-of-day caps (08:00-23:00=2M,23:00-08:00=0)
      * --update
      * self update to the latest version */
 
@@ -44,6 +54,14 @@ int main(int argc, char *argv[])
     ("f,filename", "Custom filename for exported file", cxxopts::value<std::string>()->default_value("links.txt"))
     ("z,zip", "Create a zip from downloaded items", cxxopts::value<bool>()->default_value("false"))
     ("rm-source", "Delete source files after zipping", cxxopts::value<bool>()->default_value("false"))
+    ("c,connections", "Connections per download (auto, 1-16)", cxxopts::value<std::string>()->default_value("1"))
+    ("p,parallel", "Episodes downloaded at the same time (1-8)", cxxopts::value<int>()->default_value("1"))
+    ("page-workers", "Series and episode pages fetched at the same time (1-16)", cxxopts::value<int>()->default_value("4"))
+    ("resolve-workers", "Kwik links resolved at the same time (1-8)", cxxopts::value<int>()->default_value("2"))
+    ("no-cache", "Ignore cached pages, API responses and resolved links", cxxopts::value<bool>()->default_value("false"))
+    ("order", "Download order (episode, largest)", cxxopts::value<std::string>()->default_value("episode"))
+    ("limit", "Bandwidth limit for all downloads (0, 500K, 2M)", cxxopts::value<std::string>()->default_value("0"))
+    ("limit-schedule", "Time-of-day limits (08:00-23:00=2M,23:00-08:00=0)", cxxopts::value<std::string>()->default_value(""))
     ("upgrade", "Update to the latest version")
     ("h,help", "Print usage");
 
@@ -75,6 +93,14 @@ int main(int argc, char *argv[])
         bool createZip = result["zip"].as<bool>();
         bool removeSource = result["rm-source"].as<bool>();
         std::string export_filename = result["filename"].as<std::string>();
+        std::string connections = result["connections"].as<std::string>();
+        int parallelDownloads = result["parallel"].as<int>();
+        int pageWorkers = result["page-workers"].as<int>();
+        int resolveWorkers = result["resolve-workers"].as<int>();
+        bool noCache = result["no-cache"].as<bool>();
+        std::string order = result["order"].as<std::string>();
+        std::string limit = result["limit"].as<std::string>();
+        std::string limitSchedule = result["limit-schedule"].as<std::string>();
 
         if (!isFullSeriesURL(link) && !isEpisodeURL(link))
         {
@@ -96,6 +122,34 @@ int main(int argc, char *argv[])
         {
             throw std::runtime_error(fmt::format("{} is not valid for -a,--audio [jp|en|zh]", audioLang));
         }
+        if (!isValidConnectionsFormat(connections))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for -c,--connections [auto|1-16]", connections));
+        }
+        if (parallelDownloads < 1 || parallelDownloads > 8)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for -p,--parallel [1-8]", parallelDownloads));
+        }
+        if (pageWorkers < 1 || pageWorkers > 16)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --page-workers [1-16]", pageWorkers));
+        }
+        if (resolveWorkers < 1 || resolveWorkers > 8)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --resolve-workers [1-8]", resolveWorkers));
+        }
+        if (order != "episode" && order != "largest")
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --order [episode|largest]", order));
+        }
+        if (!isValidRateFormat(limit))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --limit [0|500K|2M]", limit));
+        }
+        if (!limitSchedule.empty() && !isValidRateScheduleFormat(limitSchedule))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --limit-schedule [HH:MM-HH:MM=RATE,...]", limitSchedule));
+        }
         if (exportLinks && createZip)
         {
             /* exporting method takes prority */
@@ -118,8 +172,24 @@ int main(int argc, char *argv[])
             fmt::print("\n");
         }
 
+        DownloadOptions downloadOptions;
+        downloadOptions.connections = connections == "auto" ? 0 : std::stoi(connections);
+        downloadOptions.parallelDownloads = parallelDownloads;
+        downloadOptions.order = order == "largest" ? DownloadOrder::LargestFirst : DownloadOrder::Episode;
+        downloadOptions.rateLimit = parseRate(limit);
+        if (!limitSchedule.empty())
+        {
+            downloadOptions.rateSchedule = parseRateSchedule(limitSchedule);
+        }
+
+        ExtractOptions extractOptions;
+        extractOptions.pageWorkers = pageWorkers;
+        extractOptions.resolveWorkers = resolveWorkers;
+        extractOptions.useCache = !noCache;
+
         // Create an instance of Animepahe and call the extractor method
         Animepahe animepahe;
+        animepahe.setOptions(extractOptions);
         animepahe.extractor(
             isFullSeriesURL(link),
             link,
@@ -130,7 +200,8 @@ int main(int argc, char *argv[])
             export_filename,
             exportLinks,
             createZip,
-            removeSource
+            removeSource,
+            downloadOptions
         );
     }
     catch (const cxxopts::exceptions::option_has_no_value)
@@ -140,7 +211,7 @@ int main(int argc, char *argv[])
     }
     catch (const cxxopts::exceptions::missing_argument)
     {
-        fmt::print("\n Usage: -l,--link \"https://animepahe.si/anime/....\" -e,--episodes [all,3,1-12] -q,--quality [0-max,-1-min,720|360] -a,--audio [jp|en|zh] -x,--export, -f,--filename [filename] -z,--zip, --rm-source, --upgrade\n\n");
+        fmt::print("\n Usage: -l,--link \"https://animepahe.si/anime/....\" -e,--episodes [all,3,1-12] -q,--quality [0-max,-1-min,720|360] -a,--audio [jp|en|zh] -x,--export, -f,--filename [filename] -z,--zip, --rm-source, -c,--connections [auto|1-16], -p,--parallel [1-8], --page-workers [1-16], --resolve-workers [1-8], --no-cache, --order [episode|largest], --limit [0|500K|2M], --limit-schedule [HH:MM-HH:MM=RATE,...], --upgrade\n\n");
         return 1;
     }
     catch (const std::runtime_error &e)
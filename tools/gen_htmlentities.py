@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Writes include/htmlentities_table.hpp, the named character references of
+HTML5 in a perfect hash, for libs/htmlentities.cpp.
+
+    python3 tools/gen_htmlentities.py > include/htmlentities_table.hpp
+
+The list is Python's html.entities.html5, which follows the WHATWG
+entities.json. Names without the semicolon are the legacy references HTML
+still accepts without one. nGt; and nLt; are left out: they are the only
+two whose UTF-8 is longer than the reference itself, and the decoder
+writes in place.
+
+Hash and displace: FNV-1a 64 of the name picks one of BUCKETS buckets with
+its top bits; a key lands in slot (h + d * ((h >> 12) | 1)) % SLOTS, with
+one displacement d per bucket chosen here so that no two keys share a slot.
+entityHash() in libs/htmlentities.cpp must match fnv1a() below.
+"""
+import html.entities
+import sys
+
+SLOTS = 4096
+BUCKETS = 1024
+EXCLUDED = {"nGt;", "nLt;"}
+
+
+def fnv1a(name):
+    h = 0xcbf29ce484222325
+    for b in name.encode():
+        h = ((h ^ b) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def slot(h, d):
+    return (h + d * ((h >> 12) | 1)) % SLOTS
+
+
+def literal(data):
+    out = '"'
+    for b in data:
+        c = chr(b)
+        if c in '"\\':
+            out += "\\" + c
+        elif 0x20 <= b < 0x7F:
+            out += c
+        else:
+            out += "\\%03o" % b
+    return out + '"'
+
+
+def main():
+    names = sorted(n for n in html.entities.html5 if n not in EXCLUDED)
+    for n in names:
+        assert len(html.entities.html5[n].encode()) <= len(n) + 1, n
+
+    buckets = [[] for _ in range(BUCKETS)]
+    for i, n in enumerate(names):
+        buckets[fnv1a(n) >> 54].append(i)
+
+    displacement = [0] * BUCKETS
+    slots = [0] * SLOTS
+    for b in sorted(range(BUCKETS), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+        hashes = [fnv1a(names[i]) for i in buckets[b]]
+        for d in range(SLOTS):
+            taken = [slot(h, d) for h in hashes]
+            if len(set(taken)) == len(taken) and not any(slots[s] for s in taken):
+                displacement[b] = d
+                for i, s in zip(buckets[b], taken):
+                    slots[s] = i + 1
+                break
+        else:
+            sys.exit("no displacement for bucket %d" % b)
+
+    w = sys.stdout.write
+    w("#pragma once\n\n")
+    w("/* Generated by tools/gen_htmlentities.py, do not edit. */\n")
+    w("#include <cstddef>\n#include <cstdint>\n#include <string_view>\n\n")
+    w("namespace AnimepaheCLI::HtmlEntityTable\n{\n")
+    w("    struct Entity\n    {\n        std::string_view name;\n        std::string_view value;\n    };\n\n")
+    w("    inline constexpr size_t SLOTS = %d;\n" % SLOTS)
+    w("    inline constexpr size_t BUCKETS = %d;\n" % BUCKETS)
+    w("    /* longest name, semicolon included */\n")
+    w("    inline constexpr size_t MAX_NAME = %d;\n" % max(len(n) for n in names))
+    w("    /* longest name of a legacy reference, the ones valid without a semicolon */\n")
+    w("    inline constexpr size_t MAX_LEGACY_NAME = %d;\n\n" % max(len(n) for n in names if not n.endswith(";")))
+
+    w("    inline constexpr Entity entities[] = {\n")
+    for n in names:
+        w("        {%s, %s},\n" % (literal(n.encode()), literal(html.entities.html5[n].encode())))
+    w("    };\n\n")
+
+    def rows(values, per):
+        for i in range(0, len(values), per):
+            w("        " + ", ".join(str(v) for v in values[i:i + per]) + ",\n")
+
+    w("    /* per bucket, the step a key's slot is moved by */\n")
+    w("    inline constexpr uint16_t displacement[BUCKETS] = {\n")
+    rows(displacement, 16)
+    w("    };\n\n")
+    w("    /* index into entities plus one, 0 for a free slot */\n")
+    w("    inline constexpr uint16_t slots[SLOTS] = {\n")
+    rows(slots, 16)
+    w("    };\n")
+    w("}\n")
+
+
+if __name__ == "__main__":
+    main()